@@ -3,6 +3,7 @@
 #include <solanaceae/contact/contact_store_i.hpp>
 
 #include <solanaceae/ircclient/ircclient.hpp>
+#include <solanaceae/ircclient/ircclient_pool.hpp>
 #include <solanaceae/ircclient_contacts/ircclient_contact_model.hpp>
 #include <solanaceae/ircclient_messages/ircclient_message_manager.hpp>
 
@@ -12,6 +13,7 @@
 #include <entt/fwd.hpp>
 
 #include <memory>
+#include <vector>
 #include <iostream>
 
 static std::unique_ptr<IRCClient1> g_ircc = nullptr;
@@ -19,6 +21,11 @@ static std::unique_ptr<IRCClientContactModel> g_ircccm = nullptr;
 static std::unique_ptr<IRCClientMessageManager> g_irccmm = nullptr;
 static ContactStore4I* g_cs_ptr = nullptr;
 
+// multi network mode, if IRCClientPool.networks is set
+static std::unique_ptr<IRCClientPool> g_ircc_pool = nullptr;
+static std::vector<std::unique_ptr<IRCClientContactModel>> g_pool_ircccm;
+static std::vector<std::unique_ptr<IRCClientMessageManager>> g_pool_irccmm;
+
 constexpr const char* plugin_name = "IRCClient";
 
 extern "C" {
@@ -43,16 +50,35 @@ SOLANA_PLUGIN_EXPORT uint32_t solana_plugin_start(struct SolanaAPI* solana_api)
 		auto* rmm = PLUG_RESOLVE_INSTANCE(RegistryMessageModelI);
 		auto* conf = PLUG_RESOLVE_INSTANCE(ConfigModelI);
 
-		// static store, could be anywhere tho
-		// construct with fetched dependencies
-		g_ircc = std::make_unique<IRCClient1>(*conf);
-		g_ircccm = std::make_unique<IRCClientContactModel>(*g_cs_ptr, *conf, *g_ircc);
-		g_irccmm = std::make_unique<IRCClientMessageManager>(*rmm, *g_cs_ptr, *conf, *g_ircc, *g_ircccm);
-
-		// register types
-		PLUG_PROVIDE_INSTANCE(IRCClient1, plugin_name, g_ircc.get());
-		PLUG_PROVIDE_INSTANCE(IRCClientContactModel, plugin_name, g_ircccm.get());
-		PLUG_PROVIDE_INSTANCE(IRCClientMessageManager, plugin_name, g_irccmm.get());
+		bool use_pool {false};
+		for (const auto& [network, enabled] : conf->entries_bool("IRCClientPool", "networks")) {
+			if (enabled) {
+				use_pool = true;
+				break;
+			}
+		}
+
+		if (use_pool) {
+			g_ircc_pool = std::make_unique<IRCClientPool>(*conf);
+			for (size_t i = 0; i < g_ircc_pool->size(); i++) {
+				auto& ircc = g_ircc_pool->getClient(i);
+				g_pool_ircccm.push_back(std::make_unique<IRCClientContactModel>(*g_cs_ptr, *conf, ircc));
+				g_pool_irccmm.push_back(std::make_unique<IRCClientMessageManager>(*rmm, *g_cs_ptr, *conf, ircc, *g_pool_ircccm.back()));
+			}
+
+			PLUG_PROVIDE_INSTANCE(IRCClientPool, plugin_name, g_ircc_pool.get());
+		} else {
+			// static store, could be anywhere tho
+			// construct with fetched dependencies
+			g_ircc = std::make_unique<IRCClient1>(*conf);
+			g_ircccm = std::make_unique<IRCClientContactModel>(*g_cs_ptr, *conf, *g_ircc);
+			g_irccmm = std::make_unique<IRCClientMessageManager>(*rmm, *g_cs_ptr, *conf, *g_ircc, *g_ircccm);
+
+			// register types
+			PLUG_PROVIDE_INSTANCE(IRCClient1, plugin_name, g_ircc.get());
+			PLUG_PROVIDE_INSTANCE(IRCClientContactModel, plugin_name, g_ircccm.get());
+			PLUG_PROVIDE_INSTANCE(IRCClientMessageManager, plugin_name, g_irccmm.get());
+		}
 
 		Contact::registerIRCComponents2Str(*g_cs_ptr);
 	} catch (const ResolveException& e) {
@@ -71,9 +97,16 @@ SOLANA_PLUGIN_EXPORT void solana_plugin_stop(void) {
 	g_irccmm.reset();
 	g_ircccm.reset();
 	g_ircc.reset();
+
+	g_pool_irccmm.clear();
+	g_pool_ircccm.clear();
+	g_ircc_pool.reset();
 }
 
 SOLANA_PLUGIN_EXPORT float solana_plugin_tick(float delta) {
+	if (g_ircc_pool) {
+		return g_ircc_pool->iterate(delta);
+	}
 	return g_ircc->iterate(delta);
 }
 
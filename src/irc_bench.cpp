@@ -0,0 +1,486 @@
+#include <solanaceae/util/simple_config_model.hpp>
+#include <solanaceae/contact/contact_store_impl.hpp>
+#include <solanaceae/contact/components.hpp>
+#include <solanaceae/message3/registry_message_model_impl.hpp>
+#include <solanaceae/message3/components.hpp>
+#include <solanaceae/ircclient/ircclient.hpp>
+#include <solanaceae/ircclient/recorder.hpp>
+#include <solanaceae/ircclient_contacts/ircclient_contact_model.hpp>
+#include <solanaceae/ircclient_contacts/components.hpp>
+#include <solanaceae/ircclient_messages/ircclient_message_manager.hpp>
+
+#include "./mock_irc_server.hpp"
+
+#include <libircclient.h>
+
+#include <sys/resource.h>
+#include <sys/select.h>
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+
+// end to end ingest bench against MockIRCServer on loopback
+// native transport -> IRCClient1 -> contact model -> message manager -> throwEventConstruct
+//
+// usage: irc_bench [--channels <n>] [--users <n>] [--joins <n>] [--messages <n>] [--rate <lines/s>] [--payload <bytes>] [--threaded] [--lazy-members] [--transport native|libircclient] [--loop spin|iterate|select] [--idle <seconds>]
+// --messages 0 only times the joins and the names bursts, eg. --users 10000 --messages 0
+// --lazy-members only creates contacts for users that speak
+// --loop is how the host drives the client once setup is done:
+//   spin (default) calls iterate back to back, for throughput
+//   iterate sleeps for what iterate returns, like a real host
+//   select is the old libircclient loop (1ms select, then the host sleeps 0.1s or 1s), for comparison
+// --idle keeps the host loop running for that long after the flood and reports its cpu use
+// eg. wake to dispatch latency and idle cpu, old vs new: --users 100 --messages 200 --rate 20 --idle 10 --loop select|iterate
+//
+// usage: irc_bench --dispatch <n> [--payload <bytes>]
+// no server, feeds n channel PRIVMSGs to a replay client with one listener,
+// reports ns and heap allocations per dispatched PRIVMSG (parse + event dispatch only)
+//
+// usage: irc_bench --replay <recording> [--transport native|libircclient] [--threaded]
+// the mock server sends the incoming lines of a recording (IRCClient.record) as fast as they are read,
+// reports lines/s and MiB/s through the whole pipeline, eg. to compare the native parser with libircclient
+
+// counts every heap allocation of the process, only read around the --dispatch loop
+static std::atomic_size_t g_allocations {0};
+
+void* operator new(size_t size) {
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+		return ptr;
+	}
+	throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+namespace {
+
+uint64_t nowNS(void) {
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()
+	).count());
+}
+
+// sits at the end of the pipeline, where a ui would
+class LatencyObserver : public RegistryMessageModelEventI {
+	RegistryMessageModelI::SubscriptionReference _rmm_sr;
+
+	public:
+		std::vector<uint64_t> latencies_ns;
+
+		explicit LatencyObserver(RegistryMessageModelI& rmm) : _rmm_sr(rmm.newSubRef(this)) {
+			_rmm_sr.subscribe(RegistryMessageModel_Event::message_construct);
+		}
+
+	protected:
+		bool onEvent(const Message::Events::MessageConstruct& e) override {
+			const uint64_t now = nowNS();
+
+			if (!e.e.all_of<Message::Components::MessageText>()) {
+				return false;
+			}
+
+			const std::string_view text {e.e.get<Message::Components::MessageText>().text};
+			if (text.substr(0, 2) != "t=") {
+				return false;
+			}
+
+			uint64_t sent {0};
+			const auto res = std::from_chars(text.data() + 2, text.data() + text.size(), sent);
+			if (res.ec != std::errc{} || sent > now) {
+				return false;
+			}
+
+			latencies_ns.push_back(now - sent);
+			return false;
+		}
+};
+
+double percentileUS(std::vector<uint64_t>& values, double p) {
+	if (values.empty()) {
+		return 0.;
+	}
+	const size_t index = std::min(values.size() - 1, static_cast<size_t>(p * static_cast<double>(values.size())));
+	std::nth_element(values.begin(), values.begin() + index, values.end());
+	return static_cast<double>(values[index]) / 1000.;
+}
+
+// user + system time of the whole process
+double processCPUSeconds(void) {
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	return
+		static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+		+ static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6
+	;
+}
+
+class ChannelCounter : public IRCClientEventI {
+	IRCClient1::SubscriptionReference _ircc_sr;
+
+	public:
+		size_t count {0};
+
+		explicit ChannelCounter(IRCClient1& ircc) : _ircc_sr(ircc.newSubRef(this)) {
+			_ircc_sr.subscribe(IRCClient_Event::CHANNEL);
+		}
+
+	protected:
+		bool onEvent(const IRCClient::Events::Channel& e) override {
+			// touch it, like a real listener would
+			count += e.params.size();
+			return false;
+		}
+};
+
+int runDispatch(size_t messages, size_t payload_size) {
+	SimpleConfigModel conf;
+	conf.set("IRCClient", "transport", std::string_view{"replay"});
+	conf.set("IRCClient", "server", std::string_view{"mock"});
+	conf.set("IRCClient", "nick", std::string_view{"bench"});
+
+	IRCClient1 ircc{conf};
+	ChannelCounter counter{ircc};
+
+	// built up front, so only the client is timed
+	const std::string payload(payload_size, 'x');
+	std::vector<std::string> lines;
+	for (size_t i = 0; i < 64; i++) {
+		const std::string sender = "u" + std::to_string(i);
+		lines.push_back(":" + sender + "!" + sender + "@mock PRIVMSG " + MockIRCServer::channelName(i % 4) + " :" + payload);
+	}
+
+	// warm up, lazy buffers and the like
+	for (size_t i = 0; i < 1000; i++) {
+		ircc.feedLine(lines[i % lines.size()]);
+	}
+	ircc.iterate(0.f);
+	counter.count = 0;
+
+	const size_t allocations_start = g_allocations.load(std::memory_order_relaxed);
+	const auto start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < messages; i++) {
+		ircc.feedLine(lines[i % lines.size()]);
+	}
+
+	const auto end = std::chrono::steady_clock::now();
+	const size_t allocations = g_allocations.load(std::memory_order_relaxed) - allocations_start;
+
+	const double ns = std::chrono::duration<double, std::nano>(end - start).count();
+	std::cout
+		<< "dispatched " << messages << " PRIVMSGs (" << payload_size << " byte payload) in " << ns / 1e6 << "ms\n"
+		<< "  " << (messages > 0 ? ns / static_cast<double>(messages) : 0.) << " ns/msg"
+		<< ", " << (messages > 0 ? static_cast<double>(allocations) / static_cast<double>(messages) : 0.) << " allocations/msg\n"
+	;
+
+	return counter.count == messages * 2 ? 0 : 2;
+}
+
+enum class HostLoop {
+	spin,
+	iterate,
+	select,
+};
+
+void printUsage(const char* name) {
+	std::cerr << "usage: " << name << " [--channels <n>] [--users <n>] [--joins <n>] [--messages <n>] [--rate <lines/s>] [--payload <bytes>] [--threaded] [--lazy-members] [--transport native|libircclient] [--loop spin|iterate|select] [--idle <seconds>]\n";
+	std::cerr << "       " << name << " --dispatch <n> [--payload <bytes>]\n";
+	std::cerr << "       " << name << " --replay <recording> [--transport native|libircclient] [--threaded]\n";
+}
+
+} // anonymous
+
+int main(int argc, char** argv) {
+	MockIRCServer::Script script;
+	bool threaded {false};
+	bool lazy_members {false};
+	HostLoop host_loop {HostLoop::spin};
+	double idle_seconds {0.};
+	size_t dispatch_messages {0};
+	std::string transport {"native"};
+	std::string replay_path;
+
+	for (int i = 1; i < argc; i++) {
+		const std::string_view arg {argv[i]};
+		const bool has_value = i+1 < argc;
+		if (arg == "--threaded") {
+			threaded = true;
+		} else if (arg == "--lazy-members") {
+			lazy_members = true;
+		} else if (arg == "--channels" && has_value) {
+			script.channels = std::max<size_t>(1, std::stoul(argv[++i]));
+		} else if (arg == "--users" && has_value) {
+			script.users_per_channel = std::stoul(argv[++i]);
+		} else if (arg == "--joins" && has_value) {
+			script.joins = std::stoul(argv[++i]);
+		} else if (arg == "--messages" && has_value) {
+			script.messages = std::stoul(argv[++i]);
+		} else if (arg == "--rate" && has_value) {
+			script.rate = std::stod(argv[++i]);
+		} else if (arg == "--payload" && has_value) {
+			script.payload_size = std::stoul(argv[++i]);
+		} else if (arg == "--transport" && has_value) {
+			transport = argv[++i];
+			if (transport != "native" && transport != "libircclient") {
+				printUsage(argv[0]);
+				return 1;
+			}
+		} else if (arg == "--replay" && has_value) {
+			replay_path = argv[++i];
+		} else if (arg == "--dispatch" && has_value) {
+			dispatch_messages = std::stoul(argv[++i]);
+		} else if (arg == "--idle" && has_value) {
+			idle_seconds = std::stod(argv[++i]);
+		} else if (arg == "--loop" && has_value) {
+			const std::string_view value {argv[++i]};
+			if (value == "spin") {
+				host_loop = HostLoop::spin;
+			} else if (value == "iterate") {
+				host_loop = HostLoop::iterate;
+			} else if (value == "select") {
+				host_loop = HostLoop::select;
+			} else {
+				printUsage(argv[0]);
+				return 1;
+			}
+		} else {
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (dispatch_messages > 0) {
+		return runDispatch(dispatch_messages, script.payload_size);
+	}
+
+	if (host_loop == HostLoop::select && threaded) {
+		std::cerr << "--loop select drives the libircclient session directly, it cant be --threaded\n";
+		return 1;
+	}
+
+	if (!replay_path.empty()) {
+		IRCClient::RecordingReader reader;
+		if (!reader.open(replay_path)) {
+			std::cerr << "failed to open '" << replay_path << "'\n";
+			return 1;
+		}
+
+		IRCClient::RecordingReader::Record rec;
+		while (reader.next(rec)) {
+			if (rec.dir == IRCClient::Direction::in) {
+				script.replay_lines.emplace_back(rec.line);
+			}
+		}
+
+		if (script.replay_lines.empty()) {
+			std::cerr << "no incoming lines in '" << replay_path << "'\n";
+			return 1;
+		}
+	}
+
+	MockIRCServer server{script};
+	if (!server.start()) {
+		std::cerr << "failed to start the mock server\n";
+		return 1;
+	}
+
+	SimpleConfigModel conf;
+	conf.set("IRCClient", "server", std::string_view{"127.0.0.1"});
+	conf.set("IRCClient", "port", int64_t{server.getPort()});
+	// the old loop only existed for libircclient
+	conf.set("IRCClient", "transport", std::string_view{host_loop == HostLoop::select ? "libircclient" : transport});
+	conf.set("IRCClient", "nick", std::string_view{"bench"});
+	conf.set("IRCClient", "threaded", threaded);
+	conf.set("IRCClient", "flood_control", false);
+	conf.set("IRCClient", "lazy_members", lazy_members);
+	// the recording brings its own channels
+	for (size_t i = 0; script.replay_lines.empty() && i < script.channels; i++) {
+		conf.set("IRCClient", "autojoin", MockIRCServer::channelName(i), true);
+	}
+
+	ContactStore4Impl cs;
+	RegistryMessageModelImpl rmm{cs};
+
+	IRCClient1 ircc{conf};
+	IRCClientContactModel ircccm{cs, conf, ircc};
+	IRCClientMessageManager irccmm{rmm, cs, conf, ircc, ircccm};
+
+	if (!script.replay_lines.empty()) {
+		const auto replay_start = std::chrono::steady_clock::now();
+		while (!server.isFloodDone()) {
+			ircc.iterate(0.001f);
+			if (std::chrono::steady_clock::now() - replay_start > std::chrono::minutes{5}) {
+				std::cerr << "stalled\n";
+				return 2;
+			}
+		}
+
+		const auto& stats = server.getReplayStats();
+		server.stop();
+
+		std::cout
+			<< "replayed " << stats.lines << " lines (" << stats.bytes << " bytes) in " << stats.seconds << "s"
+			<< " with " << (host_loop == HostLoop::select ? "libircclient" : transport) << (threaded ? ", threaded" : "") << "\n"
+			<< "  " << (stats.seconds > 0. ? static_cast<double>(stats.lines) / stats.seconds : 0.) << " lines/s"
+			<< ", " << (stats.seconds > 0. ? static_cast<double>(stats.bytes) / stats.seconds / (1024.*1024.) : 0.) << " MiB/s\n"
+			<< "  contacts: " << cs.registry().storage<Contact::Components::ID>().size() << "\n"
+		;
+
+		return 0;
+	}
+
+	LatencyObserver observer{rmm};
+	observer.latencies_ns.reserve(script.messages);
+
+	// the first channel exists once we joined, names are done once every channel has all members (+ self)
+	const auto channelsWithMembers = [&](size_t min_members) {
+		size_t count {0};
+		for (size_t i = 0; i < script.channels; i++) {
+			const auto c = ircccm.getC(MockIRCServer::channelName(i));
+			const auto* member_count = static_cast<bool>(c) ? c.try_get<Contact::Components::IRC::MemberCount>() : nullptr;
+			if (member_count != nullptr && member_count->count >= min_members) {
+				count++;
+			}
+		}
+		return count;
+	};
+
+	// one round of the host loop, after setup
+	auto last_step = std::chrono::steady_clock::now();
+	const auto hostStep = [&](void) {
+		if (host_loop == HostLoop::spin) {
+			ircc.iterate(0.001f);
+			return;
+		}
+
+		if (host_loop == HostLoop::iterate) {
+			const auto now = std::chrono::steady_clock::now();
+			const float wait = ircc.iterate(std::chrono::duration<float>(now - last_step).count());
+			last_step = now;
+			std::this_thread::sleep_for(std::chrono::duration<float>(wait));
+			return;
+		}
+
+		// what iterate did before the poller (and DispatchDone) existed
+		// the host slept 0.1s if an event fired, 1s otherwise, we go by the observer
+		const size_t before = observer.latencies_ns.size();
+
+		irc_session_t* session = ircc.getSession();
+		timeval tv{0, 1000};
+		fd_set in_set, out_set;
+		int maxfd {0};
+		FD_ZERO(&in_set);
+		FD_ZERO(&out_set);
+		irc_add_select_descriptors(session, &in_set, &out_set, &maxfd);
+		if (::select(maxfd + 1, &in_set, &out_set, nullptr, &tv) >= 0) {
+			irc_process_select_descriptors(session, &in_set, &out_set);
+		}
+
+		std::this_thread::sleep_for(observer.latencies_ns.size() != before ? std::chrono::milliseconds{100} : std::chrono::milliseconds{1000});
+	};
+
+	const auto start = std::chrono::steady_clock::now();
+	auto names_start = start;
+	auto names_end = start;
+	bool joined {false};
+	bool names_done {false};
+	auto first_message = start;
+	auto last_progress = start;
+	size_t last_count {0};
+	double flood_cpu_start {0.};
+
+	while (!names_done || observer.latencies_ns.size() < script.messages) {
+		// setup always spins, its timed on its own
+		if (names_done) {
+			hostStep();
+		} else {
+			ircc.iterate(0.001f);
+		}
+
+		const auto now = std::chrono::steady_clock::now();
+		if (!names_done) {
+			if (!joined && static_cast<bool>(ircccm.getC(MockIRCServer::channelName(0)))) {
+				joined = true;
+				names_start = now;
+			}
+			if (joined && channelsWithMembers(script.users_per_channel + 1) == script.channels) {
+				names_done = true;
+				names_end = now;
+				flood_cpu_start = processCPUSeconds() - server.getCPUSeconds();
+			}
+		}
+
+		if (observer.latencies_ns.size() != last_count) {
+			if (last_count == 0) {
+				first_message = now;
+			}
+			last_count = observer.latencies_ns.size();
+			last_progress = now;
+		} else if (now - last_progress > std::chrono::seconds{10}) {
+			std::cerr << "stalled, " << (server.isFloodDone() ? "after" : "during") << " the flood\n";
+			break;
+		}
+	}
+
+	const auto end = std::chrono::steady_clock::now();
+	const double flood_cpu = processCPUSeconds() - server.getCPUSeconds() - flood_cpu_start;
+	const double flood_seconds = std::chrono::duration<double>(end - names_end).count();
+
+	// nothing arrives, only pings would
+	double idle_cpu {0.};
+	if (idle_seconds > 0.) {
+		const double idle_cpu_start = processCPUSeconds() - server.getCPUSeconds();
+		const auto idle_start = std::chrono::steady_clock::now();
+		while (std::chrono::steady_clock::now() - idle_start < std::chrono::duration<double>(idle_seconds)) {
+			hostStep();
+		}
+		idle_cpu = processCPUSeconds() - server.getCPUSeconds() - idle_cpu_start;
+		idle_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - idle_start).count();
+	}
+
+	server.stop();
+
+	const size_t received = observer.latencies_ns.size();
+	const double seconds = std::chrono::duration<double>(end - first_message).count();
+
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+
+	std::cout
+		<< "setup (connect, joins, names): " << std::chrono::duration<double>(first_message - start).count() << "s\n"
+		<< "  names: " << script.channels << "x" << script.users_per_channel << " users applied in "
+		<< std::chrono::duration<double, std::milli>(names_end - names_start).count() << "ms" << (names_done ? "" : " (incomplete)") << "\n"
+		<< "ingested " << received << "/" << script.messages << " messages in " << seconds << "s"
+		<< " (" << script.channels << " channels, " << script.users_per_channel << " users, " << script.joins << " joins)\n"
+		<< "  " << (seconds > 0. ? static_cast<double>(received) / seconds : 0.) << " msgs/s\n"
+		<< "  wire to construct latency: p50 " << percentileUS(observer.latencies_ns, 0.50) << "us"
+		<< ", p99 " << percentileUS(observer.latencies_ns, 0.99) << "us\n"
+		<< "  client cpu during the flood: " << (flood_seconds > 0. ? flood_cpu / flood_seconds * 100. : 0.) << "% of a core\n"
+		<< "  peak rss: " << usage.ru_maxrss / 1024 << " MiB (process, includes the mock server)\n"
+		<< "  contacts: " << cs.registry().storage<Contact::Components::ID>().size() << "\n"
+		<< "  contact events: " << ircccm.getUpdateStats().thrown << " thrown, " << ircccm.getUpdateStats().requested << " requested\n"
+	;
+
+	if (idle_seconds > 0.) {
+		std::cout << "idle for " << idle_seconds << "s: client cpu " << idle_cpu / idle_seconds * 1000. << "ms/s\n";
+	}
+
+	return received == script.messages ? 0 : 2;
+}
+
@@ -0,0 +1,117 @@
+#include <solanaceae/util/simple_config_model.hpp>
+#include <solanaceae/contact/contact_store_impl.hpp>
+#include <solanaceae/contact/components.hpp>
+#include <solanaceae/message3/registry_message_model_impl.hpp>
+#include <solanaceae/ircclient/ircclient.hpp>
+#include <solanaceae/ircclient/recorder.hpp>
+#include <solanaceae/ircclient_contacts/ircclient_contact_model.hpp>
+#include <solanaceae/ircclient_messages/ircclient_message_manager.hpp>
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+// feeds a recording (IRCClient.record) through the client, contact model and message manager
+// no network, deterministic, at full speed or in real time
+//
+// usage: irc_replay <recording> [--realtime] [--loops <n>]
+
+int main(int argc, char** argv) {
+	std::string path;
+	bool realtime {false};
+	int loops {1};
+
+	for (int i = 1; i < argc; i++) {
+		const std::string_view arg {argv[i]};
+		if (arg == "--realtime") {
+			realtime = true;
+		} else if (arg == "--loops" && i+1 < argc) {
+			loops = std::max(1, std::stoi(argv[++i]));
+		} else if (path.empty()) {
+			path = arg;
+		} else {
+			std::cerr << "usage: " << argv[0] << " <recording> [--realtime] [--loops <n>]\n";
+			return 1;
+		}
+	}
+
+	if (path.empty()) {
+		std::cerr << "usage: " << argv[0] << " <recording> [--realtime] [--loops <n>]\n";
+		return 1;
+	}
+
+	IRCClient::RecordingReader probe;
+	if (!probe.open(path)) {
+		std::cerr << "failed to open '" << path << "'\n";
+		return 1;
+	}
+
+	SimpleConfigModel conf;
+	conf.set("IRCClient", "transport", std::string_view{"replay"});
+	conf.set("IRCClient", "server", std::string_view{probe.getServer().empty() ? std::string_view{"replay"} : std::string_view{probe.getServer()}});
+	if (!probe.getNick().empty()) {
+		conf.set("IRCClient", "nick", std::string_view{probe.getNick()});
+	}
+
+	ContactStore4Impl cs;
+	RegistryMessageModelImpl rmm{cs};
+
+	IRCClient1 ircc{conf};
+	IRCClientContactModel ircccm{cs, conf, ircc};
+	IRCClientMessageManager irccmm{rmm, cs, conf, ircc, ircccm};
+
+	uint64_t lines_in {0};
+	uint64_t lines_out {0};
+	uint64_t bytes_in {0};
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for (int loop = 0; loop < loops; loop++) {
+		IRCClient::RecordingReader reader;
+		if (!reader.open(path)) {
+			return 1;
+		}
+
+		const auto loop_start = std::chrono::steady_clock::now();
+
+		IRCClient::RecordingReader::Record rec;
+		while (reader.next(rec)) {
+			if (rec.dir == IRCClient::Direction::out) {
+				lines_out++;
+				continue;
+			}
+
+			if (realtime) {
+				std::this_thread::sleep_until(loop_start + rec.time);
+			}
+
+			ircc.feedLine(rec.line);
+			lines_in++;
+			bytes_in += rec.line.size() + 2;
+
+			// deadlines, queues, like the host would
+			if (realtime || lines_in % 256 == 0) {
+				ircc.iterate(0.f);
+			}
+		}
+		ircc.iterate(0.f);
+	}
+
+	const auto end = std::chrono::steady_clock::now();
+	const double seconds = std::chrono::duration<double>(end - start).count();
+
+	std::cout
+		<< "replayed " << lines_in << " lines (" << bytes_in << " bytes) in " << seconds << "s"
+		<< ", skipped " << lines_out << " outgoing\n"
+		<< "  " << (seconds > 0. ? lines_in / seconds : 0.) << " lines/s"
+		<< ", " << (seconds > 0. ? bytes_in / seconds / (1024.*1024.) : 0.) << " MiB/s\n"
+		<< "  contacts: " << cs.registry().storage<Contact::Components::ID>().size() << "\n"
+		<< "  contact events: " << ircccm.getUpdateStats().thrown << " thrown, " << ircccm.getUpdateStats().requested << " requested\n"
+	;
+
+	return 0;
+}
+
@@ -0,0 +1,389 @@
+#include "./mock_irc_server.hpp"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+
+#include <chrono>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+
+namespace {
+
+// non blocking connection, reads (and mostly ignores) whatever the client sends while writing
+class Conn {
+	int _fd;
+	std::string _in;
+	std::string _out;
+	size_t _out_offset {0};
+	bool _closed {false};
+
+	public:
+		explicit Conn(int fd) : _fd(fd) {}
+
+		bool closed(void) const { return _closed; }
+		std::string& out(void) { return _out; }
+
+		// waits up to timeout_ms for io, sends what it can, buffers what it reads
+		void pump(int timeout_ms) {
+			pollfd pfd{};
+			pfd.fd = _fd;
+			pfd.events = POLLIN | (_out_offset < _out.size() ? POLLOUT : 0);
+
+			if (poll(&pfd, 1, timeout_ms) <= 0) {
+				return;
+			}
+
+			if ((pfd.revents & (POLLIN | POLLHUP | POLLERR)) != 0) {
+				char buf[4096];
+				for (;;) {
+					const ssize_t ret = ::recv(_fd, buf, sizeof(buf), 0);
+					if (ret > 0) {
+						_in.append(buf, static_cast<size_t>(ret));
+					} else {
+						if (ret == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+							_closed = true;
+						}
+						break;
+					}
+				}
+			}
+
+			while (_out_offset < _out.size()) {
+				const ssize_t ret = ::send(_fd, _out.data() + _out_offset, _out.size() - _out_offset, MSG_NOSIGNAL);
+				if (ret <= 0) {
+					if (errno != EAGAIN && errno != EWOULDBLOCK) {
+						_closed = true;
+					}
+					break;
+				}
+				_out_offset += static_cast<size_t>(ret);
+			}
+
+			if (_out_offset == _out.size()) {
+				_out.clear();
+				_out_offset = 0;
+			}
+		}
+
+		bool pendingOut(void) const {
+			return _out_offset < _out.size();
+		}
+
+		// complete lines received so far
+		template<typename Fn>
+		void lines(Fn&& fn) {
+			size_t begin {0};
+			for (;;) {
+				const auto nl = _in.find('\n', begin);
+				if (nl == std::string::npos) {
+					break;
+				}
+				std::string_view line {_in.data() + begin, nl - begin};
+				if (!line.empty() && line.back() == '\r') {
+					line.remove_suffix(1);
+				}
+				fn(line);
+				begin = nl + 1;
+			}
+			_in.erase(0, begin);
+		}
+};
+
+uint64_t nowNS(void) {
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()
+	).count());
+}
+
+} // anonymous
+
+MockIRCServer::MockIRCServer(const Script& script) : _script(script) {
+}
+
+MockIRCServer::~MockIRCServer(void) {
+	stop();
+}
+
+bool MockIRCServer::start(void) {
+	_listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+	if (_listen_fd < 0) {
+		return false;
+	}
+
+	const int one = 1;
+	setsockopt(_listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	sockaddr_in addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	if (::bind(_listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(_listen_fd, 1) != 0) {
+		::close(_listen_fd);
+		_listen_fd = -1;
+		return false;
+	}
+
+	socklen_t len = sizeof(addr);
+	getsockname(_listen_fd, reinterpret_cast<sockaddr*>(&addr), &len);
+	_port = ntohs(addr.sin_port);
+
+	_thread = std::thread(&MockIRCServer::run, this);
+
+	return true;
+}
+
+void MockIRCServer::stop(void) {
+	_stop = true;
+	if (_thread.joinable()) {
+		_thread.join();
+	}
+	if (_listen_fd >= 0) {
+		::close(_listen_fd);
+		_listen_fd = -1;
+	}
+}
+
+uint16_t MockIRCServer::getPort(void) const {
+	return _port;
+}
+
+bool MockIRCServer::isFloodDone(void) const {
+	return _flood_done;
+}
+
+size_t MockIRCServer::getPrivmsgsReceived(void) const {
+	return _privmsgs_received;
+}
+
+const MockIRCServer::ReplayStats& MockIRCServer::getReplayStats(void) const {
+	return _replay_stats;
+}
+
+double MockIRCServer::getCPUSeconds(void) {
+	if (!_thread.joinable()) {
+		return 0.;
+	}
+
+	clockid_t clock_id;
+	timespec ts{};
+	if (pthread_getcpuclockid(_thread.native_handle(), &clock_id) != 0 || clock_gettime(clock_id, &ts) != 0) {
+		return 0.;
+	}
+
+	return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
+
+std::string MockIRCServer::channelName(size_t i) {
+	return "#bench" + std::to_string(i);
+}
+
+void MockIRCServer::run(void) {
+	while (!_stop) {
+		pollfd pfd{};
+		pfd.fd = _listen_fd;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, 50) <= 0) {
+			continue;
+		}
+
+		const int fd = ::accept(_listen_fd, nullptr, nullptr);
+		if (fd < 0) {
+			continue;
+		}
+
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+		const int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		serve(fd);
+		::close(fd);
+		return; // one client only
+	}
+}
+
+void MockIRCServer::serve(int fd) {
+	Conn conn{fd};
+	std::string nick {"*"};
+
+	// registration
+	bool registered {false};
+	while (!_stop && !conn.closed() && !registered) {
+		conn.pump(10);
+		conn.lines([&](std::string_view line) {
+			if (line.substr(0, 5) == "NICK ") {
+				nick = line.substr(5);
+			} else if (line.substr(0, 5) == "USER ") {
+				registered = true;
+			}
+		});
+	}
+
+	conn.out() += ":mock 001 " + nick + " :Welcome to the mock network\r\n";
+	conn.out() += ":mock 376 " + nick + " :End of /MOTD command.\r\n";
+
+	if (!_script.replay_lines.empty()) {
+		while (!_stop && !conn.closed() && conn.pendingOut()) {
+			conn.pump(10);
+		}
+
+		const auto replay_start = std::chrono::steady_clock::now();
+
+		// in chunks, so the client is already chewing while we append
+		size_t next {0};
+		bool pinged {false};
+		bool ponged {false};
+		while (!_stop && !conn.closed() && !ponged) {
+			auto& out = conn.out();
+			for (; next < _script.replay_lines.size() && out.size() < 256*1024; next++) {
+				const auto& line = _script.replay_lines[next];
+				out += line;
+				out += "\r\n";
+				_replay_stats.bytes += line.size() + 2;
+			}
+			if (next == _script.replay_lines.size() && !pinged) {
+				out += "PING :mock-replay-done\r\n";
+				pinged = true;
+			}
+
+			conn.pump(conn.pendingOut() ? 1 : 10);
+			conn.lines([&](std::string_view line) {
+				if (line.substr(0, 5) == "PONG " && line.find("mock-replay-done") != std::string_view::npos) {
+					ponged = true;
+				}
+			});
+		}
+
+		_replay_stats.lines = next;
+		_replay_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - replay_start).count();
+		_flood_done = true;
+
+		while (!_stop && !conn.closed()) {
+			conn.pump(50);
+			conn.lines([](std::string_view) {});
+		}
+		return;
+	}
+
+	// joins, each answered with a names burst
+	std::vector<bool> joined(_script.channels, false);
+	size_t joined_count {0};
+	while (!_stop && !conn.closed() && joined_count < _script.channels) {
+		conn.pump(10);
+		conn.lines([&](std::string_view line) {
+			if (line.substr(0, 5) != "JOIN ") {
+				return;
+			}
+
+			std::string_view list = line.substr(5);
+			list = list.substr(0, list.find(' ')); // no keys
+			while (!list.empty()) {
+				const auto comma = list.find(',');
+				const std::string channel {list.substr(0, comma)};
+				list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma+1);
+
+				if (channel.size() <= 6 || channel.substr(0, 6) != "#bench") {
+					continue;
+				}
+				const size_t index = std::stoul(channel.substr(6));
+				if (index >= joined.size() || joined[index]) {
+					continue;
+				}
+				joined[index] = true;
+				joined_count++;
+
+				auto& out = conn.out();
+				out += ":" + nick + "!" + nick + "@mock JOIN " + channel + "\r\n";
+
+				const std::string names_prefix = ":mock 353 " + nick + " = " + channel + " :";
+				std::string names_line = names_prefix + nick;
+				for (size_t u = 0; u < _script.users_per_channel; u++) {
+					if (names_line.size() > 400) {
+						out += names_line + "\r\n";
+						names_line = names_prefix;
+					} else {
+						names_line += ' ';
+					}
+					if (u % 50 == 0) {
+						names_line += '@';
+					} else if (u % 10 == 0) {
+						names_line += '+';
+					}
+					names_line += "u" + std::to_string(u);
+				}
+				out += names_line + "\r\n";
+				out += ":mock 366 " + nick + " " + channel + " :End of /NAMES list.\r\n";
+			}
+		});
+	}
+
+	while (!_stop && !conn.closed() && conn.pendingOut()) {
+		conn.pump(10);
+	}
+
+	// what the client sends from here on, so tests can see where messages went
+	const auto count_privmsg = [this](std::string_view line) {
+		if (line.substr(0, 8) == "PRIVMSG ") {
+			_privmsgs_received++;
+		}
+	};
+
+	// flood
+	const std::string payload(_script.payload_size, 'x');
+	const auto flood_start = std::chrono::steady_clock::now();
+	size_t sent_messages {0};
+	size_t sent_joins {0};
+	const size_t users = _script.users_per_channel > 0 ? _script.users_per_channel : 1;
+	const size_t channels = _script.channels > 0 ? _script.channels : 1;
+
+	while (!_stop && !conn.closed() && sent_messages < _script.messages) {
+		// lines due by now, batched so we dont syscall per line
+		size_t budget {1024};
+		if (_script.rate > 0.) {
+			const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - flood_start).count();
+			const double due = elapsed * _script.rate - static_cast<double>(sent_messages + sent_joins);
+			budget = due < 1. ? 0 : std::min<size_t>(1024, static_cast<size_t>(due));
+		}
+
+		auto& out = conn.out();
+		for (size_t i = 0; i < budget && sent_messages < _script.messages; i++) {
+			// spread the joins evenly over the messages
+			if (sent_joins < _script.joins && sent_joins * _script.messages <= sent_messages * _script.joins) {
+				const std::string joiner = "n" + std::to_string(sent_joins);
+				out += ":" + joiner + "!" + joiner + "@mock JOIN " + channelName(sent_joins % channels) + "\r\n";
+				sent_joins++;
+				continue;
+			}
+
+			const std::string sender = "u" + std::to_string(sent_messages % users);
+			out += ":" + sender + "!" + sender + "@mock PRIVMSG " + channelName(sent_messages % channels);
+			out += " :t=" + std::to_string(nowNS()) + " " + payload + "\r\n";
+			sent_messages++;
+		}
+
+		// dont wait, unless we are paced or the client is not keeping up
+		conn.pump(conn.pendingOut() || budget == 0 ? 1 : 0);
+		conn.lines(count_privmsg);
+	}
+
+	while (!_stop && !conn.closed() && conn.pendingOut()) {
+		conn.pump(10);
+	}
+
+	_flood_done = true;
+
+	// keep the connection up until the client is done
+	while (!_stop && !conn.closed()) {
+		conn.pump(50);
+		conn.lines(count_privmsg);
+	}
+}
+
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// scripted irc server stand-in on loopback, for benchmarks and tests (see irc_bench, test_pool)
+// serves exactly one client:
+// 1. registration, 001 + 376 once USER arrives (CAP is ignored, like an old ircd)
+// 2. every JOIN gets the join echo and a NAMES burst of users_per_channel
+// 3. once all channels are joined, floods joins and PRIVMSGs at the configured rate
+// PRIVMSG text starts with "t=<steady clock ns> ", so the client can measure latency
+//
+// with replay_lines, 2. and 3. are replaced by sending those lines as fast as the client reads them,
+// followed by a PING the client has to answer, so the time covers everything being processed
+class MockIRCServer {
+	public:
+		struct Script {
+			size_t channels {1};
+			size_t users_per_channel {1000};
+			size_t joins {0}; // new users joining during the flood
+			size_t messages {100000};
+			double rate {0.}; // lines per second, 0 is as fast as possible
+			size_t payload_size {64};
+
+			std::vector<std::string> replay_lines; // without crlf
+		};
+
+		struct ReplayStats {
+			size_t lines {0};
+			size_t bytes {0}; // crlf included
+			double seconds {0.}; // first byte sent until the PONG arrived
+		};
+
+	private:
+		Script _script;
+
+		int _listen_fd {-1};
+		uint16_t _port {0};
+
+		std::thread _thread;
+		std::atomic_bool _stop {false};
+		std::atomic_bool _flood_done {false};
+		std::atomic_size_t _privmsgs_received {0}; // after the joins
+		ReplayStats _replay_stats; // written before _flood_done is set
+
+	public:
+		explicit MockIRCServer(const Script& script);
+		~MockIRCServer(void);
+
+		// binds to 127.0.0.1 on a random port
+		bool start(void);
+		void stop(void);
+
+		uint16_t getPort(void) const;
+		bool isFloodDone(void) const;
+		// PRIVMSGs the client sent once all channels were joined
+		size_t getPrivmsgsReceived(void) const;
+		// valid once the flood is done
+		const ReplayStats& getReplayStats(void) const;
+
+		// cpu time spent by the server thread, so benches can subtract it from the process
+		double getCPUSeconds(void);
+
+		static std::string channelName(size_t i);
+
+	private:
+		void run(void);
+		void serve(int fd);
+};
+
@@ -0,0 +1,104 @@
+#include "./casefold.hpp"
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <immintrin.h>
+	#define IRCC_CASEFOLD_SSE2 1
+#endif
+
+namespace IRCClient {
+
+namespace {
+
+// all mappings fold one contiguous range starting at 'A' by adding 0x20
+// ascii A-Z, strict-rfc1459 A-], rfc1459 A-^
+constexpr char lastFolded(CaseMapping mapping) {
+	switch (mapping) {
+		case CaseMapping::rfc1459: return '^';
+		case CaseMapping::strict_rfc1459: return ']';
+		case CaseMapping::ascii:
+		case CaseMapping::rfc7613:
+		default: return 'Z';
+	}
+}
+
+constexpr std::array<uint8_t, 256> makeTable(char last) {
+	std::array<uint8_t, 256> table {};
+	for (size_t i = 0; i < table.size(); i++) {
+		table[i] = static_cast<uint8_t>(i);
+		if (i >= static_cast<uint8_t>('A') && i <= static_cast<uint8_t>(last)) {
+			table[i] += 0x20;
+		}
+	}
+	return table;
+}
+
+constexpr std::array<uint8_t, 256> ascii_table {makeTable(lastFolded(CaseMapping::ascii))};
+constexpr std::array<uint8_t, 256> rfc1459_table {makeTable(lastFolded(CaseMapping::rfc1459))};
+constexpr std::array<uint8_t, 256> strict_rfc1459_table {makeTable(lastFolded(CaseMapping::strict_rfc1459))};
+
+static_assert(rfc1459_table['['] == '{' && rfc1459_table['~'] == '~' && rfc1459_table['^'] == '~');
+static_assert(strict_rfc1459_table['\\'] == '|' && strict_rfc1459_table['^'] == '^');
+static_assert(ascii_table['Q'] == 'q' && ascii_table['['] == '[' && ascii_table[0xC4] == 0xC4);
+
+} // anonymous
+
+const std::array<uint8_t, 256>& foldTable(CaseMapping mapping) {
+	switch (mapping) {
+		case CaseMapping::rfc1459: return rfc1459_table;
+		case CaseMapping::strict_rfc1459: return strict_rfc1459_table;
+		case CaseMapping::ascii:
+		case CaseMapping::rfc7613:
+		default: return ascii_table;
+	}
+}
+
+void foldInto(CaseMapping mapping, std::string_view name, std::string& out) {
+	out.resize(name.size());
+
+	const char* src = name.data();
+	char* dst = out.data();
+	size_t i {0};
+
+#if defined(IRCC_CASEFOLD_SSE2)
+	// bytes >= 0x80 are negative as signed chars, so they never pass the lower bound
+	const __m128i lower_bound = _mm_set1_epi8('A' - 1);
+	const __m128i upper_bound = _mm_set1_epi8(static_cast<char>(lastFolded(mapping) + 1));
+	const __m128i delta = _mm_set1_epi8(0x20);
+	for (; i + 16 <= name.size(); i += 16) {
+		const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		const __m128i in_range = _mm_and_si128(
+			_mm_cmpgt_epi8(chunk, lower_bound),
+			_mm_cmpgt_epi8(upper_bound, chunk)
+		);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_add_epi8(chunk, _mm_and_si128(in_range, delta)));
+	}
+#endif
+
+	const auto& table = foldTable(mapping);
+	for (; i < name.size(); i++) {
+		dst[i] = static_cast<char>(table[static_cast<uint8_t>(src[i])]);
+	}
+}
+
+std::string fold(CaseMapping mapping, std::string_view name) {
+	std::string res;
+	foldInto(mapping, name, res);
+	return res;
+}
+
+bool equalFold(CaseMapping mapping, std::string_view a, std::string_view b) {
+	if (a.size() != b.size()) {
+		return false;
+	}
+
+	const auto& table = foldTable(mapping);
+	for (size_t i = 0; i < a.size(); i++) {
+		if (table[static_cast<uint8_t>(a[i])] != table[static_cast<uint8_t>(b[i])]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+} // IRCClient
+
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+namespace IRCClient {
+
+	// CASEMAPPING, how the server compares nick and channel names
+	// every mapping only folds ascii, bytes >= 0x80 are left as is
+	enum class CaseMapping : uint8_t {
+		ascii, // A-Z
+		rfc1459, // also folds []\^ to {}|~
+		strict_rfc1459, // also folds []\ to {}|
+		rfc7613, // utf-8 aware, we only fold the ascii part
+	};
+
+	// byte -> folded byte
+	const std::array<uint8_t, 256>& foldTable(CaseMapping mapping);
+
+	// replaces out with the folded name, reusing its buffer
+	// long names are folded 16 bytes at a time where sse2 is available
+	void foldInto(CaseMapping mapping, std::string_view name, std::string& out);
+
+	std::string fold(CaseMapping mapping, std::string_view name);
+
+	// same as fold(a) == fold(b), without building either
+	bool equalFold(CaseMapping mapping, std::string_view a, std::string_view b);
+
+} // IRCClient
+
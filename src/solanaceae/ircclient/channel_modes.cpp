@@ -0,0 +1,111 @@
+#include "./channel_modes.hpp"
+
+#include <iterator>
+
+namespace IRCClient {
+
+namespace {
+
+// by mode letter first, since some servers use other prefix chars
+uint8_t privilegeFor(char mode, char prefix) {
+	switch (mode) {
+		case 'q': return ChannelModes::founder;
+		case 'a': return ChannelModes::protect;
+		case 'o': return ChannelModes::op;
+		case 'h': return ChannelModes::halfop;
+		case 'v': return ChannelModes::voice;
+		default: break;
+	}
+	switch (prefix) {
+		case '~': return ChannelModes::founder;
+		case '&': return ChannelModes::protect;
+		case '@': return ChannelModes::op;
+		case '%': return ChannelModes::halfop;
+		case '+': return ChannelModes::voice;
+		default: break;
+	}
+	return 0;
+}
+
+bool inTable(char c) {
+	return static_cast<unsigned char>(c) < 128;
+}
+
+} // anonymous
+
+ChannelModes::ChannelModes(void) {
+	reset();
+}
+
+void ChannelModes::reset(void) {
+	parseChanModes("beI,k,l,imnpst");
+	parsePrefix("(ov)@+");
+}
+
+void ChannelModes::parsePrefix(std::string_view value) {
+	for (size_t i = 0; i < _types.size(); i++) {
+		if (_types[i] == Type::prefix) {
+			_types[i] = Type::unknown;
+		}
+	}
+	_mode_privileges.fill(0);
+	_prefix_privileges.fill(0);
+	_prefixes.clear();
+
+	// "(modes)prefixes", same length
+	const auto close = value.find(')');
+	if (value.empty() || value.front() != '(' || close == std::string_view::npos) {
+		return;
+	}
+	const auto modes = value.substr(1, close-1);
+	const auto prefixes = value.substr(close+1);
+
+	for (size_t i = 0; i < modes.size() && i < prefixes.size(); i++) {
+		if (!inTable(modes[i]) || !inTable(prefixes[i])) {
+			continue;
+		}
+		const auto privilege = privilegeFor(modes[i], prefixes[i]);
+		_types[static_cast<unsigned char>(modes[i])] = Type::prefix;
+		_mode_privileges[static_cast<unsigned char>(modes[i])] = privilege;
+		_prefix_privileges[static_cast<unsigned char>(prefixes[i])] = privilege;
+		_prefixes += prefixes[i];
+	}
+}
+
+void ChannelModes::parseChanModes(std::string_view value) {
+	for (auto& t : _types) {
+		if (t != Type::prefix) {
+			t = Type::unknown;
+		}
+	}
+
+	// A,B,C,D, more groups might follow and are ignored
+	static constexpr Type group_types[] {Type::list, Type::always, Type::set_only, Type::never};
+	size_t group {0};
+	for (const char c : value) {
+		if (c == ',') {
+			group++;
+			if (group >= std::size(group_types)) {
+				break;
+			}
+			continue;
+		}
+		// prefix modes win, they can not be listed here anyway
+		if (inTable(c) && _types[static_cast<unsigned char>(c)] != Type::prefix) {
+			_types[static_cast<unsigned char>(c)] = group_types[group];
+		}
+	}
+}
+
+uint8_t ChannelModes::stripPrefixes(std::string_view& nick) const {
+	uint8_t privileges {0};
+	// a prefix without a known privilege still is a prefix
+	while (!nick.empty() && _prefixes.find(nick.front()) != std::string::npos) {
+		privileges |= _prefix_privileges[static_cast<unsigned char>(nick.front())];
+		nick.remove_prefix(1);
+	}
+	return privileges;
+}
+
+} // IRCClient
+
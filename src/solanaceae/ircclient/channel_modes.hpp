@@ -0,0 +1,109 @@
+#pragma once
+
+#include "./params.hpp"
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+namespace IRCClient {
+
+	// table driven channel mode decoding, filled from the PREFIX and CHANMODES
+	// RPL_ISUPPORT tokens, with the rfc defaults until the server sends them
+	class ChannelModes {
+		public:
+			// CHANMODES types, decide if a mode takes an argument
+			enum class Type : uint8_t {
+				unknown, // not advertised, assumed to take none
+				list, // A, always (eg. b)
+				always, // B, always (eg. k)
+				set_only, // C, only when set (eg. l)
+				never, // D (eg. m)
+				prefix, // from PREFIX, always a nick (eg. o)
+			};
+
+			// membership privileges as bits, the same on every server
+			enum Privilege : uint8_t {
+				founder = 1u << 0, // ~ q
+				protect = 1u << 1, // & a
+				op = 1u << 2, // @ o
+				halfop = 1u << 3, // % h
+				voice = 1u << 4, // + v
+			};
+
+			struct Change {
+				bool set {true};
+				char mode {0};
+				std::string_view arg; // empty if the mode has none
+			};
+
+		private:
+			std::array<Type, 128> _types {};
+			std::array<uint8_t, 128> _mode_privileges {}; // mode letter -> Privilege
+			std::array<uint8_t, 128> _prefix_privileges {}; // prefix char -> Privilege
+			std::string _prefixes; // as advertised, highest first
+
+		public:
+			ChannelModes(void);
+
+			// back to PREFIX=(ov)@+ CHANMODES=beI,k,l,imnpst
+			void reset(void);
+
+			// eg. "(qaohv)~&@%+", empty means no prefixes
+			void parsePrefix(std::string_view value);
+			// eg. "beI,k,l,imnpst"
+			void parseChanModes(std::string_view value);
+
+			Type type(char mode) const {
+				const auto i = static_cast<unsigned char>(mode);
+				return i < _types.size() ? _types[i] : Type::unknown;
+			}
+
+			// 0 if not a prefix mode
+			uint8_t modePrivilege(char mode) const {
+				const auto i = static_cast<unsigned char>(mode);
+				return i < _mode_privileges.size() ? _mode_privileges[i] : 0;
+			}
+
+			// strips the membership prefixes (more than one with multi-prefix)
+			// from the front of a NAMES entry, returns them as Privilege bits
+			uint8_t stripPrefixes(std::string_view& nick) const;
+
+			// calls fn(const Change&) for each change in a channel MODE
+			// modes is eg. "+o-v+l", args the params that follow it
+			// returns false if it ran out of args (the rest is skipped)
+			template<typename FN>
+			bool decode(std::string_view modes, Params args, FN&& fn) const {
+				bool set {true};
+				size_t next_arg {0};
+				for (const char mode : modes) {
+					if (mode == '+' || mode == '-') {
+						set = mode == '+';
+						continue;
+					}
+
+					const Type t = type(mode);
+					const bool has_arg =
+						t == Type::list ||
+						t == Type::always ||
+						t == Type::prefix ||
+						(t == Type::set_only && set)
+					;
+
+					Change change{set, mode, {}};
+					if (has_arg) {
+						if (next_arg >= args.size()) {
+							return false;
+						}
+						change.arg = args[next_arg++];
+					}
+
+					fn(change);
+				}
+				return true;
+			}
+	};
+
+} // IRCClient
+
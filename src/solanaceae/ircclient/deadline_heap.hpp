@@ -0,0 +1,132 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include <array>
+#include <optional>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+namespace IRCClient {
+
+// min-heap of deadlines, one live deadline per key
+// re-setting or canceling a key leaves the old entry in the heap,
+// it gets dropped once it surfaces (lazy deletion)
+// Key is an enum with a MAX entry
+template<typename Key>
+class DeadlineHeap {
+	public:
+		using Clock = std::chrono::steady_clock;
+		using TimePoint = Clock::time_point;
+
+	private:
+		struct Entry {
+			TimePoint time;
+			Key key;
+			uint32_t generation;
+		};
+
+		std::vector<Entry> _heap;
+
+		// current generation per key, entries with an older one are stale
+		std::array<uint32_t, static_cast<size_t>(Key::MAX)> _generation {};
+		std::array<bool, static_cast<size_t>(Key::MAX)> _armed {};
+
+		static bool later(const Entry& a, const Entry& b) {
+			return a.time > b.time;
+		}
+
+		bool isLive(const Entry& e) const {
+			const auto i = static_cast<size_t>(e.key);
+			return _armed[i] && _generation[i] == e.generation;
+		}
+
+		void dropStale(void) {
+			while (!_heap.empty() && !isLive(_heap.front())) {
+				std::pop_heap(_heap.begin(), _heap.end(), later);
+				_heap.pop_back();
+			}
+		}
+
+	public:
+		void set(Key key, TimePoint time) {
+			const auto i = static_cast<size_t>(key);
+			_generation[i]++;
+			_armed[i] = true;
+
+			_heap.push_back({time, key, _generation[i]});
+			std::push_heap(_heap.begin(), _heap.end(), later);
+		}
+
+		// only moves the deadline closer, never further away
+		void setEarlier(Key key, TimePoint time) {
+			if (const auto current = get(key); current.has_value() && current.value() <= time) {
+				return;
+			}
+			set(key, time);
+		}
+
+		void cancel(Key key) {
+			const auto i = static_cast<size_t>(key);
+			_generation[i]++;
+			_armed[i] = false;
+		}
+
+		bool armed(Key key) const {
+			return _armed[static_cast<size_t>(key)];
+		}
+
+		// O(n), only used for setEarlier on a handful of keys
+		std::optional<TimePoint> get(Key key) const {
+			if (!armed(key)) {
+				return std::nullopt;
+			}
+
+			const auto generation = _generation[static_cast<size_t>(key)];
+			for (const auto& e : _heap) {
+				if (e.key == key && e.generation == generation) {
+					return e.time;
+				}
+			}
+			return std::nullopt;
+		}
+
+		std::optional<TimePoint> next(void) {
+			dropStale();
+			if (_heap.empty()) {
+				return std::nullopt;
+			}
+			return _heap.front().time;
+		}
+
+		// disarms and returns the earliest expired key, if any
+		std::optional<Key> popExpired(TimePoint now) {
+			dropStale();
+			if (_heap.empty() || _heap.front().time > now) {
+				return std::nullopt;
+			}
+
+			const Key key = _heap.front().key;
+			std::pop_heap(_heap.begin(), _heap.end(), later);
+			_heap.pop_back();
+
+			_armed[static_cast<size_t>(key)] = false;
+			return key;
+		}
+
+		// seconds until the next deadline, clamped to [0, max_wait]
+		float secondsUntilNext(TimePoint now, float max_wait) {
+			const auto n = next();
+			if (!n.has_value()) {
+				return max_wait;
+			}
+			if (n.value() <= now) {
+				return 0.f;
+			}
+			return std::min(std::chrono::duration<float>(n.value() - now).count(), max_wait);
+		}
+};
+
+} // IRCClient
+
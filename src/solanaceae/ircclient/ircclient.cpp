@@ -1,43 +1,80 @@
 #include "./ircclient.hpp"
 
+#include "./socket.hpp"
+#include "./recorder.hpp"
+
 #include <libircclient.h>
 #include <libirc_rfcnumeric.h>
 
+#include <cassert>
 #include <cstdint>
-#include <iostream>
+#include <cmath>
+#include <algorithm>
 #include <random>
 #include <stdexcept>
 #include <vector>
 #include <string_view>
 
 void IRCClient1::on_event_numeric(irc_session_t* session, unsigned int event, const char* origin, const char** params, unsigned int count) {
-	std::vector<std::string_view> params_view;
-	for (size_t i = 0; i < count; i++) {
-		params_view.push_back(params[i]);
+	std::array<std::string_view, IRCClient::max_params> params_array;
+	const size_t params_count = std::min<size_t>(count, params_array.size());
+	if (params_count < count) {
+		IRCC_LOG_WARN("IRCC warning: numeric " << event << " has " << count << " params, dropping all past " << params_count);
 	}
+	for (size_t i = 0; i < params_count; i++) {
+		params_array[i] = params[i];
+	}
+	const IRCClient::Params params_view{params_array.data(), params_count};
 
-#if 0
-	std::cout << "IRC: event_numeric " << event << " " << origin << "\n";
-
-	for (const auto it : params_view) {
-		std::cout << "  " << it << "\n";
+	if (IRCC_LOG_ENABLED(IRCClient::Log::Level::trace)) {
+		IRCClient::Log::Line line{IRCClient::Log::Level::trace};
+		line << "IRC: event_numeric " << event << " o:" << origin;
+		for (const auto it : params_view) {
+			line << " '" << it << "'";
+		}
 	}
-#endif
 
 	auto ircc = static_cast<IRCClient1*>(irc_get_ctx(session));
-	ircc->dispatch(IRCClient_Event::NUMERIC, IRCClient::Events::Numeric{event, origin, params_view});
-	ircc->_event_fired = true;
+
+	ircc->emitEvent(
+		IRCClient_Event::NUMERIC, event,
+		origin != nullptr ? std::optional<std::string_view>{origin} : std::nullopt,
+		params_view
+	);
 }
 
 IRCClient1::IRCClient1(
-	ConfigModelI& conf
-) : _conf(conf) {
+	ConfigModelI& conf,
+	std::string_view config_section
+) : _conf(conf), _config_section(config_section) {
+	_own_poller = std::make_unique<IRCClientPoller>();
+	_poller = _own_poller.get();
+
+	init(_conf.get_bool(_config_section, "threaded").value_or(false));
 
+	if (_threaded) {
+		_io_thread = std::thread(&IRCClient1::ioThreadMain, this);
+	}
+}
+
+IRCClient1::IRCClient1(
+	ConfigModelI& conf,
+	std::string_view config_section,
+	IRCClientPoller& poller,
+	bool threaded
+) : _conf(conf), _config_section(config_section) {
+	_poller = &poller;
+	_external_io = true;
+
+	init(threaded);
+}
+
+void IRCClient1::init(bool threaded) {
 	static irc_callbacks_t cb{};
 
 	cb.event_numeric = on_event_numeric;
 
-#define IRC_CB_G(x0, x1, x2) cb.x0 = on_event_generic_new<IRCClient_Event::x1, IRCClient::Events::x2>;
+#define IRC_CB_G(x0, x1, x2) cb.x0 = on_event_generic_new<IRCClient_Event::x1>;
 
 	//cb.event_connect = on_event_generic_new<IRCClientContactModel_Event::CONNECT, IRCClient::Events::Connect>;
 
@@ -78,89 +115,453 @@ IRCClient1::IRCClient1(
 	irc_option_set(_irc_session, LIBIRC_OPTION_STRIPNICKS);
 	irc_option_set(_irc_session, LIBIRC_OPTION_SSL_NO_VERIFY); // why
 
+	_reconnect_interval = std::chrono::seconds{_conf.get_int(_config_section, "reconnect_interval").value_or(20)};
+	_ping_interval = std::chrono::seconds{_conf.get_int(_config_section, "ping_interval").value_or(120)};
+	_ping_timeout = std::chrono::seconds{_conf.get_int(_config_section, "ping_timeout").value_or(60)};
+	_max_wait = _conf.get_int(_config_section, "max_wait_ms").value_or(1000) / 1000.f;
+
+	// process wide, 0 trace .. 4 error, 5 off
+	if (const auto level = _conf.get_int(_config_section, "log_level"); level.has_value()) {
+		IRCClient::Log::setLevel(static_cast<IRCClient::Log::Level>(std::clamp<int64_t>(level.value(), 0, 5)));
+	}
+
+	// defaults match ircd, 5 lines burst, then one every 2 seconds
+	_flood_control = _conf.get_bool(_config_section, "flood_control").value_or(true);
+	_flood_penalty = std::chrono::milliseconds{_conf.get_int(_config_section, "flood_penalty_ms").value_or(2000)};
+	_flood_window = std::chrono::milliseconds{_conf.get_int(_config_section, "flood_window_ms").value_or(10000)};
+
+	if (!_conf.has_string(_config_section, "server")) {
+		IRCC_LOG_ERROR("IRCC error: no irc server in config!!");
+		throw std::runtime_error("missing server in config");
+	}
+
+	// if server is prefixed with '#', its ssl
+	_server = _conf.get_string(_config_section, "server").value();
+	_server_name = _server; // TODO: find a better solution
+	_port = static_cast<uint16_t>(_conf.get_int(_config_section, "port").value_or(6660));
+	// TODO: password
+
+	// "libircclient" (default) or "native"
+	_cap_negotiation = _conf.get_bool(_config_section, "ircv3").value_or(true);
+
+	const std::string transport = _conf.get_string(_config_section, "transport").value_or("libircclient");
+	if (transport == "native") {
+		if (!_server.empty() && _server.front() == '#') {
+			IRCC_LOG_WARN("IRCC warning: native transport does not do ssl, using libircclient");
+		} else {
+			_transport = Transport::native;
+		}
+	} else if (transport == "replay") {
+		_transport = Transport::replay;
+	}
+	_ssl = _transport == Transport::libircclient && !_server.empty() && _server.front() == '#';
+
+	if (_conf.has_string(_config_section, "nick")) {
+		_nick = _conf.get_string(_config_section, "nick").value();
+	} else {
+		_nick = "solanaceae_guest_" + std::to_string(std::random_device{}() % 10'000);
+	}
+
+	if (_conf.has_string(_config_section, "username")) {
+		_username = _conf.get_string(_config_section, "username").value();
+	} else {
+		_username = _nick + "_";
+	}
+
+	if (_conf.has_string(_config_section, "realname")) {
+		_realname = _conf.get_string(_config_section, "realname").value();
+	} else {
+		_realname = _username + "_";
+	}
+
+	if (_conf.has_string(_config_section, "record")) {
+		if (_transport == Transport::native) {
+			_recorder = std::make_unique<IRCClient::Recorder>();
+			if (!_recorder->open(_conf.get_string(_config_section, "record").value(), _server, _nick)) {
+				_recorder.reset();
+			}
+		} else {
+			IRCC_LOG_WARN("IRCC warning: recording needs the native transport");
+		}
+	}
+
+	_threaded = threaded && _transport != Transport::replay;
+	if (_threaded) {
+		_event_ring = std::make_unique<IRCClient::SPSCRing<EventRecord>>(
+			static_cast<size_t>(_conf.get_int(_config_section, "event_ring_size").value_or(4096))
+		);
+		_send_ring = std::make_unique<IRCClient::SPSCRing<SendRecord>>(1024);
+	}
+
 	connectSession();
 }
 
 IRCClient1::~IRCClient1(void) {
+	if (_io_thread.joinable()) {
+		_io_stop = true;
+		_poller->wake();
+		_io_thread.join();
+	}
+
+	closeSession();
 	irc_destroy_session(_irc_session);
 }
 
 // tmp
 void IRCClient1::run(void) {
 	if (irc_run(_irc_session) != 0) {
-		std::cerr << "error failed to run: " << irc_strerror(irc_errno(_irc_session)) << "\n";
+		IRCC_LOG_ERROR("IRCC error: failed to run: " << irc_strerror(irc_errno(_irc_session)));
 	}
 }
 
-float IRCClient1::iterate(float delta) {
+float IRCClient1::iterate(float) {
+	float wait {_max_wait};
+	if (_threaded) {
+		wait = drainEvents();
+	} else if (!_external_io) {
+		// (the pool drives external io)
+		wait = ioStep(0);
+	}
+
+	// also covers lines fed in between
+	dispatchDone();
+
+	return wait;
+}
+
+float IRCClient1::ioStep(int timeout_ms) {
+	ioPrepare();
+
+	// only latches readiness
+	// dont block if there is work left over
+	for (const auto& ev : _poller->wait(ioWantsImmediate() ? 0 : timeout_ms)) {
+		if (ev.user == this) {
+			ioLatch(ev);
+		}
+	}
+
+	return ioProcess();
+}
+
+void IRCClient1::ioPrepare(void) {
 	//if ( session->state != LIBIRC_STATE_CONNECTING )
 	//{
 		//session->lasterror = LIBIRC_ERR_STATE;
 		//return 1;
 	//}
 
-	if (!irc_is_connected(_irc_session)) {
-		if (_try_connecting_state) {
-			// try to connect, every 20sec
-			_try_connecting_cooldown -= delta;
-			if (_try_connecting_cooldown <= 0.f) {
-				std::cerr << "IRCC: trying to connect\n";
-				connectSession();
-			}
-		} else {
-			std::cerr << "IRCC error: not connected, trying to reconnect\n";
+	if (!ioIsConnected()) {
+		// while in the trying phase, the reconnect deadline takes care of it
+		if (!_try_connecting_state) {
+			IRCC_LOG_WARN("IRCC warning: not connected, trying to reconnect");
 
-			dispatch(IRCClient_Event::DISCONNECT, IRCClient::Events::Disconnect{});
+			emitEvent(IRCClient_Event::DISCONNECT, 0, std::nullopt, {});
 			connectSession(); // potentially enters trying phase
 		}
-		return 0.5f;
 	}
 
-	_event_fired = false;
+	const auto now = Clock::now();
 
-	struct timeval tv;
-	fd_set in_set, out_set;
-	int maxfd = 0;
+	// might queue outgoing lines (ping)
+	handleDeadlines(now);
 
-	//tv.tv_usec = 20000; // 20ms
-	tv.tv_usec = 1000; // 1ms
-	tv.tv_sec = 0;
+	if (_threaded) {
+		flushSendRing();
+	}
 
-	// Init sets
-	FD_ZERO(&in_set);
-	FD_ZERO(&out_set);
+	// everything released here is appended to libircclients outgoing buffer,
+	// which is written with a single send() in processSocket
+	releaseQueued(now);
 
-	if (irc_add_select_descriptors(_irc_session, &in_set, &out_set, &maxfd) != 0) {
-		std::cerr << "IRCC error: adding select descriptors\n";
+	_io_connected.store(ioIsConnected(), std::memory_order_relaxed);
+}
+
+bool IRCClient1::ioWantsImmediate(void) const {
+	return _sock_readable || (_pending_write && _sock_writable);
+}
+
+void IRCClient1::ioLatch(const IRCClientPoller::Event& ev) {
+	_sock_readable = _sock_readable || ev.readable;
+	_sock_writable = _sock_writable || ev.writable;
+}
+
+float IRCClient1::ioProcess(void) {
+	processSocket();
+
+	// TODO: handle dcc
+
+	if (_sock_readable) {
+		// ran out of budget, more is waiting
+		return 0.f;
 	}
 
-	if (select(maxfd + 1, &in_set, &out_set, 0, &tv) < 0) {
-		std::cerr << "IRCC error: select returned error\n";
-#if 0
-		if (socket_error() == EINTR) {
-			//continue;
-			return;
+	const bool connected = ioIsConnected();
+
+	float max_wait = _max_wait;
+	if (_threaded && _poller->canWake()) {
+		// whoever drives us blocks in the poller,
+		// socket activity, sends and stopping wake it up
+		max_wait = static_cast<float>((connected ? _ping_interval : _reconnect_interval).count());
+	} else if (!connected && !_threaded) {
+		// only the reconnect deadline is of interest
+		max_wait = static_cast<float>(_reconnect_interval.count());
+	}
+
+	return _deadlines.secondsUntilNext(Clock::now(), max_wait);
+}
+
+void IRCClient1::ioThreadMain(void) {
+	float wait {0.f};
+	while (!_io_stop.load(std::memory_order_relaxed)) {
+		// the io thread has no host to return to, so it can sleep until the next deadline
+		wait = ioStep(static_cast<int>(std::ceil(wait * 1000.f)));
+	}
+}
+
+bool IRCClient1::ioSendRaw(const std::string& line) {
+	if (_transport == Transport::replay) {
+		return true;
+	}
+
+	if (_transport == Transport::native) {
+		if (_sock == IRCClientPoller::invalid_socket) {
+			return false;
 		}
-#endif
+		if (_recorder) {
+			_recorder->record(IRCClient::Direction::out, line);
+		}
+		// written once the socket is (or stays) writable
+		_send_buffer += line;
+		_send_buffer += "\r\n";
+		_pending_write = true;
+		return true;
+	}
 
-		//session->lasterror = LIBIRC_ERR_TERMINATED;
-		//return 1;
-		return 0.1f;
+	if (irc_send_raw(_irc_session, "%s", line.c_str()) != 0) {
+		return false;
 	}
+	_pending_write = true;
+	return true;
+}
 
-	if (irc_process_select_descriptors(_irc_session, &in_set, &out_set) != 0) {
-		std::cerr << "IRCC error: processing socket select\n";
-		//return 1;
+void IRCClient1::ioEnqueue(IRCClient::SendPriority priority, std::string&& line) {
+	_send_queues[static_cast<size_t>(priority)].push_back(std::move(line));
+	updateSendQueueDepth();
+}
+
+void IRCClient1::flushSendRing(void) {
+	while (auto* rec = _send_ring->front()) {
+		ioEnqueue(rec->priority, std::move(rec->line));
+		_send_ring->pop();
 	}
+}
 
-	// TODO: handle dcc
-	if (_event_fired) {
-		return 0.1f;
+void IRCClient1::releaseQueued(Clock::time_point now) {
+	// the server drops anything before registration (ERR_NOTREGISTERED),
+	// emitEvent rearms us once 001 arrives
+	if (!_registered) {
+		updateSendQueueDepth();
+		return;
+	}
+
+	if (_flood_timer < now) {
+		_flood_timer = now;
+	}
+
+	// highest priority first
+	for (auto& queue : _send_queues) {
+		while (!queue.empty()) {
+			if (_flood_control && _flood_timer - now >= _flood_window) {
+				// over budget, come back once enough penalty drained
+				_deadlines.set(Deadline::flood_release, _flood_timer - _flood_window);
+				updateSendQueueDepth();
+				return;
+			}
+
+			if (!ioSendRaw(queue.front())) {
+				// not connected (yet) or libircclients buffer is full, retry later
+				_deadlines.setEarlier(Deadline::flood_release, now + std::chrono::seconds{1});
+				updateSendQueueDepth();
+				return;
+			}
+
+			// longer lines cost more, one extra penalty per 120 bytes
+			_flood_timer += _flood_penalty * (1 + queue.front().size() / 120);
+
+			queue.pop_front();
+		}
+	}
+
+	updateSendQueueDepth();
+}
+
+void IRCClient1::updateSendQueueDepth(void) {
+	size_t depth {0};
+	for (const auto& queue : _send_queues) {
+		depth += queue.size();
+	}
+	_send_queue_depth.store(depth, std::memory_order_relaxed);
+}
+
+float IRCClient1::drainEvents(void) {
+	// bounded, so a burst cant stall the host
+	for (size_t i = 0; i < _event_ring->capacity(); i++) {
+		const auto* rec = _event_ring->front();
+		if (rec == nullptr) {
+			return _max_wait;
+		}
+
+		dispatchRecord(*rec);
+		_event_ring->pop();
+	}
+
+	return 0.f; // more waiting
+}
+
+void IRCClient1::dispatchRecord(const EventRecord& rec) {
+	const std::string_view data {rec.data};
+
+	const IRCClient::Tags tags {data.substr(0, rec.tags_size)};
+
+	size_t offset = rec.tags_size + rec.sizes.front();
+	std::optional<std::string_view> origin;
+	if (rec.has_origin) {
+		origin = data.substr(rec.tags_size, rec.sizes.front());
+	}
+
+	std::array<std::string_view, IRCClient::max_params> params_array;
+	const size_t params_count = std::min<size_t>(rec.sizes.size() - 1, params_array.size());
+	for (size_t i = 0; i < params_count; i++) {
+		params_array[i] = data.substr(offset, rec.sizes[i+1]);
+		offset += rec.sizes[i+1];
+	}
+
+	dispatchEvent(rec.type, rec.numeric, origin, IRCClient::Params{params_array.data(), params_count}, tags);
+}
+
+void IRCClient1::dispatchEvent(IRCClient_Event type, unsigned int numeric, std::optional<std::string_view> origin, IRCClient::Params params, IRCClient::Tags tags) {
+	_event_fired = true;
+
+	switch (type) {
+		case IRCClient_Event::NUMERIC:
+			if (numeric == 1) {
+				// RPL_WELCOME, a new registration
+				_isupport.reset();
+			} else if (numeric == 5 && params.size() >= 2) {
+				// RPL_ISUPPORT, target first and text last
+				for (size_t i = 1; i+1 < params.size(); i++) {
+					_isupport.parseToken(params[i]);
+				}
+			}
+			dispatch(type, IRCClient::Events::Numeric{numeric, origin.value_or(""), params, tags});
+			break;
+
+// hack if origin is null
+#define IRC_REC_G(x1, x2) case IRCClient_Event::x1: dispatch(type, IRCClient::Events::x2{origin.value_or("<nullptr>"), params, tags}); break;
+
+		IRC_REC_G(CONNECT, Connect);
+		IRC_REC_G(NICK, Nick);
+		IRC_REC_G(QUIT, Quit);
+		IRC_REC_G(JOIN, Join);
+		IRC_REC_G(PART, Part);
+		IRC_REC_G(MODE, Mode);
+		IRC_REC_G(UMODE, UMode);
+		IRC_REC_G(TOPIC, Topic);
+		IRC_REC_G(KICK, Kick);
+
+		IRC_REC_G(CHANNEL, Channel);
+
+		IRC_REC_G(PRIVMSG, PrivMSG);
+		IRC_REC_G(NOTICE, Notice);
+		IRC_REC_G(CHANNELNOTICE, ChannelNotice);
+		IRC_REC_G(INVITE, Invite);
+
+		IRC_REC_G(CTCP_REQ, CTCP_Req);
+		IRC_REC_G(CTCP_REP, CTCP_Rep);
+		IRC_REC_G(CTCP_ACTION, CTCP_Action);
+
+		IRC_REC_G(UNKNOWN, Unknown);
+
+		IRC_REC_G(BATCH, Batch);
+
+#undef IRC_REC_G
+
+		case IRCClient_Event::DISCONNECT:
+			dispatch(type, IRCClient::Events::Disconnect{});
+			break;
+		case IRCClient_Event::DISPATCH_DONE: // not queued, see dispatchDone()
+		case IRCClient_Event::MAX: break;
+	}
+}
+
+void IRCClient1::dispatchDone(void) {
+	if (!_event_fired) {
+		return;
+	}
+	_event_fired = false;
+
+	dispatch(IRCClient_Event::DISPATCH_DONE, IRCClient::Events::DispatchDone{});
+}
+
+void IRCClient1::emitEvent(IRCClient_Event type, unsigned int numeric, std::optional<std::string_view> origin, IRCClient::Params params, IRCClient::Tags tags) {
+	_io_events++;
+
+	if (!_registered && (type == IRCClient_Event::CONNECT || (type == IRCClient_Event::NUMERIC && numeric == 1))) {
+		// before the dispatch, so lines sent from the handlers go out right away
+		_registered = true;
+		_deadlines.setEarlier(Deadline::flood_release, Clock::now());
+	}
+
+	if (_threaded) {
+		pushEvent(type, numeric, origin, params, tags);
 	} else {
-		return 1.f;
+		dispatchEvent(type, numeric, origin, params, tags);
 	}
 }
 
+void IRCClient1::pushEvent(IRCClient_Event type, unsigned int numeric, std::optional<std::string_view> origin, IRCClient::Params params, IRCClient::Tags tags) {
+	auto* rec = _event_ring->acquire();
+	while (rec == nullptr) {
+		if (_io_stop.load(std::memory_order_relaxed)) {
+			return; // shutting down, drop it
+		}
+
+		// backpressure, stop reading the socket until the main thread caught up
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		rec = _event_ring->acquire();
+	}
+
+	// reuses the slots buffers
+	rec->type = type;
+	rec->numeric = numeric;
+	rec->has_origin = origin.has_value();
+	rec->data.clear();
+	rec->sizes.clear();
+
+	rec->data.append(tags.raw());
+	rec->tags_size = tags.raw().size();
+
+	const std::string_view origin_view = origin.value_or("");
+	rec->data.append(origin_view);
+	rec->sizes.push_back(origin_view.size());
+
+	for (const auto param : params) {
+		rec->data.append(param);
+		rec->sizes.push_back(param.size());
+	}
+
+	_event_ring->commit();
+}
+
+bool IRCClient1::ioIsConnected(void) const {
+	if (_transport == Transport::native) {
+		return _sock != IRCClientPoller::invalid_socket;
+	} else if (_transport == Transport::replay) {
+		return true;
+	}
+	return irc_is_connected(_irc_session) != 0;
+}
+
 irc_session_t* IRCClient1::getSession(void) {
 	return _irc_session;
 }
@@ -169,61 +570,695 @@ const std::string_view IRCClient1::getServerName(void) const {
 	return _server_name;
 }
 
+const std::string& IRCClient1::getConfigSection(void) const {
+	return _config_section;
+}
+
+bool IRCClient1::isThreaded(void) const {
+	return _threaded;
+}
+
+bool IRCClient1::sendRaw(std::string_view line, IRCClient::SendPriority priority) {
+	if (!_threaded) {
+		if (!ioIsConnected()) {
+			return false;
+		}
+
+		ioEnqueue(priority, std::string{line});
+		// dont wait for the next iterate, if there is budget left
+		releaseQueued(Clock::now());
+		return true;
+	}
+
+	if (!_io_connected.load(std::memory_order_relaxed)) {
+		return false;
+	}
+
+	auto* slot = _send_ring->acquire();
+	if (slot == nullptr) {
+		IRCC_LOG_ERROR("IRCC error: send ring full, dropping line");
+		return false;
+	}
+
+	slot->priority = priority;
+	slot->line.assign(line);
+	_send_ring->commit();
+	_poller->wake();
+
+	return true;
+}
+
+size_t IRCClient1::maxTextLength(std::string_view target, size_t extra) const {
+	// the server prepends ":nick!~user@host ", we dont know our host (max 63)
+	const size_t prefix = 1 + _isupport.nickLen() + 2 + _isupport.userLen() + 1 + 63 + 1;
+	const size_t command = 8 + target.size() + 2; // "PRIVMSG <target> :"
+	const size_t used = 2 + prefix + command + extra; // crlf
+	// dont split into nothing, if the server lies about its limits
+	return std::max<size_t>(64, _isupport.lineLen() > used ? _isupport.lineLen() - used : 0);
+}
+
+template<typename FN>
+bool IRCClient1::splitText(std::string_view text, size_t max_length, FN&& fn) {
+	while (text.size() > max_length) {
+		size_t cut = text.rfind(' ', max_length);
+		if (cut == std::string_view::npos || cut == 0) {
+			// no space, dont cut through a utf-8 sequence
+			cut = max_length;
+			while (cut > 0 && (static_cast<unsigned char>(text[cut]) & 0xC0) == 0x80) {
+				cut--;
+			}
+			if (cut == 0) {
+				cut = max_length;
+			}
+			if (!fn(text.substr(0, cut))) {
+				return false;
+			}
+			text = text.substr(cut);
+		} else {
+			if (!fn(text.substr(0, cut))) {
+				return false;
+			}
+			text = text.substr(cut+1);
+		}
+	}
+	return fn(text);
+}
+
+bool IRCClient1::sendMessage(std::string_view target, std::string_view text) {
+	return splitText(text, maxTextLength(target, 0), [this, target](std::string_view part) {
+		std::string line;
+		line.reserve(8 + 2 + target.size() + part.size());
+		line += "PRIVMSG ";
+		line += target;
+		line += " :";
+		line += part;
+		return sendRaw(line, IRCClient::SendPriority::interactive);
+	});
+}
+
+bool IRCClient1::sendAction(std::string_view target, std::string_view text) {
+	// ctcp, same as irc_cmd_me()
+	return splitText(text, maxTextLength(target, 9), [this, target](std::string_view part) {
+		std::string line;
+		line.reserve(8 + 10 + target.size() + part.size() + 1);
+		line += "PRIVMSG ";
+		line += target;
+		line += " :\x01" "ACTION ";
+		line += part;
+		line += "\x01";
+		return sendRaw(line, IRCClient::SendPriority::interactive);
+	});
+}
+
 void IRCClient1::join(std::string_view channel) {
-	assert(false && "implement me");
+	std::string line{"JOIN "};
+	line += channel;
+	sendRaw(line, IRCClient::SendPriority::bulk);
+}
+
+bool IRCClient1::hasCap(IRCClient::Cap cap) const {
+	return (_caps.load(std::memory_order_relaxed) & (1u << static_cast<uint32_t>(cap))) != 0;
+}
+
+const IRCClient::ISupport& IRCClient1::getISupport(void) const {
+	return _isupport;
+}
+
+void IRCClient1::feedLine(std::string_view line) {
+	assert(!_threaded);
+	_last_activity = Clock::now();
+	dispatchLine(line);
+}
+
+size_t IRCClient1::getSendQueueDepth(void) const {
+	size_t depth = _send_queue_depth.load(std::memory_order_relaxed);
+	if (_send_ring) {
+		depth += _send_ring->size();
+	}
+	return depth;
 }
 
 void IRCClient1::connectSession(void) {
 	_try_connecting_state = true;
-	_try_connecting_cooldown = 20.f;
+	_deadlines.set(Deadline::reconnect, Clock::now() + _reconnect_interval);
+	_deadlines.cancel(Deadline::ping);
+	_deadlines.cancel(Deadline::ping_timeout);
+
+	closeSession();
+
+	// channels get rejoined by whoever queued them on connect
+	_send_queues[static_cast<size_t>(IRCClient::SendPriority::bulk)].clear();
+	updateSendQueueDepth();
+
+	if (_transport == Transport::native) {
+		if (!connectNative()) {
+			return;
+		}
+	} else if (_transport == Transport::replay) {
+		_registered = true; // sends are dropped anyway, dont pile them up
+		_motd_received = false;
+		_current_nick = _nick;
+		_caps_offered = 0;
+		_caps.store(0, std::memory_order_relaxed);
+	} else {
+		if (irc_connect(_irc_session, _server.c_str(), _port, nullptr, _nick.c_str(), _username.c_str(), _realname.c_str()) != 0) {
+			IRCC_LOG_ERROR("IRCC error: failed to connect: (" << irc_errno(_irc_session) << ") " << irc_strerror(irc_errno(_irc_session)));
+
+			irc_disconnect(_irc_session);
+
+			//throw std::runtime_error("failed to connect to irc");
+			return;
+		}
+
+		registerSocket();
+	}
+
+	_try_connecting_state = false;
+	_deadlines.cancel(Deadline::reconnect);
+
+	_last_activity = Clock::now();
+	_deadlines.set(Deadline::ping, _last_activity + _ping_interval);
+}
+
+void IRCClient1::closeSession(void) {
+	// remove before closing, the fd number might get reused
+	_poller->remove(_sock);
+	if (_transport == Transport::native) {
+		IRCClient::Socket::close(_sock);
+		_native_connecting = false;
+		_recv_buffer.clear();
+		_send_buffer.clear();
+	}
+	_sock = IRCClientPoller::invalid_socket;
+	_sock_readable = false;
+	_sock_writable = false;
+	_pending_write = false;
+	_registered = false;
 
 	// reset connection
 	// only closes potentially open sockets and sets state to init
 	// nothing else is touched
 	irc_disconnect(_irc_session);
+}
 
-	// TODO: do we need to set this every time?
-	if (!_conf.has_string("IRCClient", "server")) {
-		std::cerr << "IRCC error: no irc server in config!!\n";
-		throw std::runtime_error("missing server in config");
+void IRCClient1::handleDeadlines(Clock::time_point now) {
+	while (const auto key = _deadlines.popExpired(now)) {
+		switch (key.value()) {
+			case Deadline::reconnect:
+				if (!ioIsConnected()) {
+					IRCC_LOG_INFO("IRCC: trying to connect");
+					connectSession(); // rearms on failure
+				}
+				break;
+			case Deadline::ping:
+				if (now - _last_activity < _ping_interval) {
+					// there was traffic since, push it back
+					_deadlines.set(Deadline::ping, _last_activity + _ping_interval);
+					break;
+				}
+
+				// anything coming back counts, not only the pong, so the token does not matter
+				// (_server_name is the config value, it can carry the leading '#' ssl marker)
+				ioSendRaw("PING :ircc");
+				_ping_sent = now;
+				_deadlines.set(Deadline::ping_timeout, now + _ping_timeout);
+				_deadlines.set(Deadline::ping, now + _ping_interval);
+				break;
+			case Deadline::ping_timeout:
+				if (_last_activity >= _ping_sent) {
+					break;
+				}
+
+				IRCC_LOG_WARN("IRCC warning: ping timeout");
+				closeSession(); // next iterate dispatches the disconnect and reconnects
+				break;
+			case Deadline::flood_release:
+				// released in ioPrepare, right after
+				break;
+			case Deadline::MAX: break;
+		}
 	}
+}
 
-	// if server is prefixed with '#', its ssl
-	std::string server = _conf.get_string("IRCClient", "server").value();
-	_server_name = server; // TODO: find a better solution
-	int64_t port = _conf.get_int("IRCClient", "port").value_or(6660);
-	// TODO: password
+void IRCClient1::registerSocket(void) {
+	// libircclient does not expose its socket,
+	// so we fish it out of the fd_set once per connection
+	fd_set in_set, out_set;
+	FD_ZERO(&in_set);
+	FD_ZERO(&out_set);
+	int maxfd = 0;
 
-	std::string nick;
-	if (_conf.has_string("IRCClient", "nick")) {
-		nick = _conf.get_string("IRCClient", "nick").value();
-	} else {
-		nick = "solanaceae_guest_" + std::to_string(std::random_device{}() % 10'000);
+	if (irc_add_select_descriptors(_irc_session, &in_set, &out_set, &maxfd) != 0) {
+		IRCC_LOG_ERROR("IRCC error: adding select descriptors");
+		return;
 	}
 
-	std::string username;
-	if (_conf.has_string("IRCClient", "username")) {
-		username = _conf.get_string("IRCClient", "username").value();
-	} else {
-		username = nick + "_";
+#if defined(_WIN32)
+	if (in_set.fd_count > 0) {
+		_sock = in_set.fd_array[0];
+	} else if (out_set.fd_count > 0) {
+		_sock = out_set.fd_array[0];
+	}
+#else
+	for (int fd = 0; fd <= maxfd; fd++) {
+		if (FD_ISSET(fd, &in_set) || FD_ISSET(fd, &out_set)) {
+			_sock = fd;
+			break;
+		}
+	}
+#endif
+
+	if (_sock == IRCClientPoller::invalid_socket) {
+		IRCC_LOG_ERROR("IRCC error: session has no socket");
+		return;
+	}
+
+	if (!_poller->add(_sock, this)) {
+		IRCC_LOG_ERROR("IRCC error: failed to register socket");
+		_sock = IRCClientPoller::invalid_socket;
+	}
+}
+
+void IRCClient1::processSocket(void) {
+	if (_sock == IRCClientPoller::invalid_socket) {
+		return;
+	}
+
+	if (!_sock_readable && !_sock_writable) {
+		return;
+	}
+
+	if (_transport == Transport::native) {
+		processSocketNative();
+		return;
+	}
+
+	// bounded, so a flood cant starve the host
+	// if we run out, the latch stays set and we continue next iterate
+	size_t idle_rounds {0};
+	for (size_t i = 0; i < 32; i++) {
+		const uint64_t events_before = _io_events;
+
+		fd_set in_set, out_set;
+		FD_ZERO(&in_set);
+		FD_ZERO(&out_set);
+
+		if (_sock_readable) {
+			FD_SET(_sock, &in_set);
+		}
+
+		// libircclient only writes if it has something queued,
+		// so once the socket reported writable we can keep handing it out
+		if (_sock_writable) {
+			FD_SET(_sock, &out_set);
+		}
+
+		if (_sock_writable) {
+			_pending_write = false;
+		}
+
+		if (irc_process_select_descriptors(_irc_session, &in_set, &out_set) != 0) {
+			IRCC_LOG_WARN("IRCC warning: processing socket");
+			// most likely disconnected, iterate will notice
+			_sock_readable = false;
+			return;
+		}
+
+		if (!_sock_readable) {
+			return;
+		}
+
+		_last_activity = Clock::now();
+
+		// edge triggered, so we only drop the latch once the kernel buffer is drained
+		// (libircclient reads at most one buffer per call)
+		if (IRCClientPoller::pendingBytes(_sock) > 0) {
+			idle_rounds = 0;
+			continue;
+		}
+
+		if (!_ssl) {
+			_sock_readable = false;
+			return;
+		}
+
+		// ssl: openssl pulls whole records off the socket, decrypted bytes it still holds
+		// dont show up in FIONREAD and wont trigger another edge.
+		// keep reading until libircclient stops producing lines,
+		// a second empty round covers a line that straddled its buffer
+		// (an empty SSL_read is WANT_READ, which libircclient shrugs off)
+		if (_io_events != events_before) {
+			idle_rounds = 0;
+		} else if (++idle_rounds >= 2) {
+			_sock_readable = false;
+			return;
+		}
+	}
+}
+
+
+bool IRCClient1::connectNative(void) {
+	_sock = IRCClient::Socket::connectTCP(_server, _port);
+	if (_sock == IRCClientPoller::invalid_socket) {
+		return false;
+	}
+
+	if (!_poller->add(_sock, this)) {
+		IRCC_LOG_ERROR("IRCC error: failed to register socket");
+		IRCClient::Socket::close(_sock);
+		_sock = IRCClientPoller::invalid_socket;
+		return false;
+	}
+
+	_native_connecting = true;
+	_motd_received = false;
+	_current_nick = _nick;
+	_recv_buffer.clear();
+	_send_buffer.clear();
+
+	_caps_offered = 0;
+	_caps.store(0, std::memory_order_relaxed);
+	_cap_negotiating = _cap_negotiation;
+
+	if (_recorder) {
+		_recorder->comment("connect");
+	}
+
+	if (_cap_negotiation) {
+		// servers without CAP ignore it (or reply 421) and register us right away
+		ioSendRaw("CAP LS 302");
+	}
+
+	// registration, goes out as soon as the connect finished
+	// same as libircclient
+	ioSendRaw("NICK " + _nick);
+	ioSendRaw("USER " + _username + " unknown unknown :" + _realname);
+
+	return true;
+}
+
+void IRCClient1::processSocketNative(void) {
+	if (_native_connecting) {
+		// a finished (or failed) connect reports writable
+		if (!_sock_writable) {
+			return;
+		}
+
+		if (!IRCClient::Socket::finishConnect(_sock)) {
+			IRCC_LOG_ERROR("IRCC error: failed to connect to " << _server << ":" << _port);
+			closeSession();
+			// never was connected, so no disconnect, just try again later
+			_try_connecting_state = true;
+			_deadlines.set(Deadline::reconnect, Clock::now() + _reconnect_interval);
+			return;
+		}
+		_native_connecting = false;
+	}
+
+	if (_sock_writable && !_send_buffer.empty() && !flushSendBuffer()) {
+		IRCC_LOG_WARN("IRCC warning: send failed");
+		closeSession();
+		return;
+	}
+
+	// bounded, so a flood cant starve the host
+	// if we run out, the latch stays set and we continue next iterate
+	for (size_t i = 0; i < 32 && _sock_readable; i++) {
+		char* dst = _recv_buffer.writable(4096);
+
+		size_t received {0};
+		const auto res = IRCClient::Socket::recvSome(_sock, dst, _recv_buffer.writableSize(), received);
+		if (res == IRCClient::Socket::IOResult::would_block) {
+			// drained, wait for the next edge
+			_sock_readable = false;
+			break;
+		} else if (res != IRCClient::Socket::IOResult::ok) {
+			IRCC_LOG_WARN("IRCC warning: connection " << (res == IRCClient::Socket::IOResult::closed ? "closed" : "lost"));
+			closeSession(); // next iterate dispatches the disconnect and reconnects
+			return;
+		}
+
+		_recv_buffer.commit(received);
+		_last_activity = Clock::now();
+
+		_recv_buffer.consumeLines([this](std::string_view line) {
+			dispatchLine(line);
+		});
+	}
+
+	// replies queued while dispatching, eg. pong
+	if (_sock_writable && !_send_buffer.empty() && !flushSendBuffer()) {
+		IRCC_LOG_WARN("IRCC warning: send failed");
+		closeSession();
+		return;
+	}
+}
+
+bool IRCClient1::flushSendBuffer(void) {
+	size_t offset {0};
+	while (offset < _send_buffer.size()) {
+		size_t sent {0};
+		const auto res = IRCClient::Socket::sendSome(_sock, _send_buffer.data() + offset, _send_buffer.size() - offset, sent);
+		if (res == IRCClient::Socket::IOResult::would_block) {
+			// kernel buffer full, wait for the next edge
+			_sock_writable = false;
+			break;
+		} else if (res != IRCClient::Socket::IOResult::ok) {
+			return false;
+		}
+		offset += sent;
+	}
+
+	_send_buffer.erase(0, offset);
+	_pending_write = !_send_buffer.empty();
+
+	return true;
+}
+
+void IRCClient1::dispatchLine(std::string_view line) {
+	IRCC_LOG_TRACE("IRC: line '" << line << "'");
+
+	if (_recorder) {
+		_recorder->record(IRCClient::Direction::in, line);
+	}
+
+	IRCClient::Message msg;
+	if (!IRCClient::parseMessage(line, msg)) {
+		return;
+	}
+
+	dispatchMessage(msg);
+}
+
+void IRCClient1::dispatchMessage(const IRCClient::Message& msg) {
+	const auto params = msg.params();
+	const std::string_view command = msg.command;
+	const IRCClient::Tags tags {msg.tags};
+
+	// LIBIRC_OPTION_STRIPNICKS, only the nick of nick!user@host
+	std::optional<std::string_view> origin;
+	if (!msg.prefix.empty()) {
+		origin = msg.prefix.substr(0, msg.prefix.find_first_of("!@"));
+	}
+
+	if (command == "PING") {
+		// answered right away, flood control does not apply
+		ioSendRaw(params.empty() ? std::string{"PONG"} : "PONG :" + std::string{params.back()});
+		return;
+	}
+
+	if (command == "CAP") {
+		handleCap(params);
+		return;
+	}
+
+	if (command.size() == 3 && std::all_of(command.cbegin(), command.cend(), [](char c) { return c >= '0' && c <= '9'; })) {
+		const unsigned int code = static_cast<unsigned int>((command[0]-'0')*100 + (command[1]-'0')*10 + (command[2]-'0'));
+
+		if (code == 1) {
+			if (!params.empty()) {
+				_current_nick = params.front();
+			}
+			_cap_negotiating = false; // registered, too late now
+		}
+
+		// same as libircclient, connected means registered and motd is done
+		if ((code == LIBIRC_RFC_RPL_ENDOFMOTD || code == LIBIRC_RFC_ERR_NOMOTD) && !_motd_received) {
+			_motd_received = true;
+			emitEvent(IRCClient_Event::CONNECT, 0, origin, params, tags);
+		}
+
+		emitEvent(IRCClient_Event::NUMERIC, code, origin, params, tags);
+		return;
 	}
 
-	std::string realname;
-	if (_conf.has_string("IRCClient", "realname")) {
-		realname = _conf.get_string("IRCClient", "realname").value();
+	if (command == "NICK") {
+		if (origin.has_value() && origin.value() == _current_nick && !params.empty()) {
+			_current_nick = params.front();
+		}
+		emitEvent(IRCClient_Event::NICK, 0, origin, params, tags);
+	} else if (command == "QUIT") {
+		emitEvent(IRCClient_Event::QUIT, 0, origin, params, tags);
+	} else if (command == "JOIN") {
+		emitEvent(IRCClient_Event::JOIN, 0, origin, params, tags);
+	} else if (command == "PART") {
+		emitEvent(IRCClient_Event::PART, 0, origin, params, tags);
+	} else if (command == "MODE") {
+		const bool umode = !params.empty() && params.front() == _current_nick;
+		emitEvent(umode ? IRCClient_Event::UMODE : IRCClient_Event::MODE, 0, origin, params, tags);
+	} else if (command == "TOPIC") {
+		emitEvent(IRCClient_Event::TOPIC, 0, origin, params, tags);
+	} else if (command == "KICK") {
+		emitEvent(IRCClient_Event::KICK, 0, origin, params, tags);
+	} else if (command == "INVITE") {
+		emitEvent(IRCClient_Event::INVITE, 0, origin, params, tags);
+	} else if (command == "BATCH") {
+		emitEvent(IRCClient_Event::BATCH, 0, origin, params, tags);
+	} else if (command == "PRIVMSG" || command == "NOTICE") {
+		if (params.size() < 2) {
+			return;
+		}
+
+		const bool is_privmsg = command == "PRIVMSG";
+		const std::string_view text = params[1];
+
+		if (text.size() >= 2 && text.front() == '\x01' && text.back() == '\x01') {
+			const std::string_view ctcp = text.substr(1, text.size()-2);
+
+			if (!is_privmsg) {
+				emitEvent(IRCClient_Event::CTCP_REP, 0, origin, IRCClient::Params{&ctcp, 1}, tags);
+			} else if (ctcp.substr(0, 7) == "ACTION ") {
+				const std::array<std::string_view, 2> action_params {params.front(), ctcp.substr(7)};
+				emitEvent(IRCClient_Event::CTCP_ACTION, 0, origin, IRCClient::Params{action_params.data(), action_params.size()}, tags);
+			} else {
+				emitEvent(IRCClient_Event::CTCP_REQ, 0, origin, IRCClient::Params{&ctcp, 1}, tags);
+			}
+			return;
+		}
+
+		const bool to_us = params.front() == _current_nick;
+		if (is_privmsg) {
+			emitEvent(to_us ? IRCClient_Event::PRIVMSG : IRCClient_Event::CHANNEL, 0, origin, params, tags);
+		} else {
+			emitEvent(to_us ? IRCClient_Event::NOTICE : IRCClient_Event::CHANNELNOTICE, 0, origin, params, tags);
+		}
 	} else {
-		realname = username + "_";
+		emitEvent(IRCClient_Event::UNKNOWN, 0, origin, params, tags);
 	}
+}
+
+namespace {
 
-	if (irc_connect(_irc_session, server.c_str(), port, nullptr, nick.c_str(), username.c_str(), realname.c_str()) != 0) {
-		std::cerr << "IRCC error: failed to connect: (" << irc_errno(_irc_session) << ") " << irc_strerror(irc_errno(_irc_session)) << "\n";
+// indexed by IRCClient::Cap
+constexpr std::array<std::string_view, static_cast<size_t>(IRCClient::Cap::MAX)> cap_names {
+	"message-tags",
+	"server-time",
+	"batch",
+	"multi-prefix",
+	"userhost-in-names",
+};
 
-		irc_disconnect(_irc_session);
+// bits of the known caps in a space separated list, values (cap=value) are ignored
+// a '-' prefix (ACK) is reported in removed
+uint32_t capBits(std::string_view list, uint32_t* removed = nullptr) {
+	uint32_t bits {0};
+	while (!list.empty()) {
+		const auto space = list.find(' ');
+		std::string_view name = list.substr(0, space);
+		list = space == std::string_view::npos ? std::string_view{} : list.substr(space+1);
 
-		//throw std::runtime_error("failed to connect to irc");
+		bool remove {false};
+		if (!name.empty() && name.front() == '-') {
+			remove = true;
+			name = name.substr(1);
+		}
+		name = name.substr(0, name.find('='));
+
+		for (size_t i = 0; i < cap_names.size(); i++) {
+			if (cap_names[i] == name) {
+				if (remove && removed != nullptr) {
+					*removed |= 1u << i;
+				} else if (!remove) {
+					bits |= 1u << i;
+				}
+				break;
+			}
+		}
+	}
+	return bits;
+}
+
+} // anonymous
+
+void IRCClient1::handleCap(IRCClient::Params params) {
+	// <nick or *> <subcommand> [*] :<caps>
+	if (params.size() < 3) {
 		return;
 	}
 
-	_try_connecting_state = false;
+	const std::string_view subcommand = params[1];
+	const std::string_view list = params.back();
+
+	if (subcommand == "LS") {
+		_caps_offered |= capBits(list);
+
+		// 302 multiline, more to come
+		if (params.size() >= 4 && params[2] == "*") {
+			return;
+		}
+
+		if (!_cap_negotiating) {
+			return;
+		}
+
+		const uint32_t wanted = _caps_offered & ~_caps.load(std::memory_order_relaxed);
+		if (wanted != 0) {
+			requestCaps(wanted);
+		} else {
+			ioSendRaw("CAP END");
+			_cap_negotiating = false;
+		}
+	} else if (subcommand == "ACK") {
+		uint32_t removed {0};
+		const uint32_t added = capBits(list, &removed);
+		_caps.store((_caps.load(std::memory_order_relaxed) | added) & ~removed, std::memory_order_relaxed);
+
+		IRCC_LOG_INFO("IRCC: caps acknowledged '" << list << "'");
+
+		if (_cap_negotiating) {
+			ioSendRaw("CAP END");
+			_cap_negotiating = false;
+		}
+	} else if (subcommand == "NAK") {
+		IRCC_LOG_WARN("IRCC warning: caps rejected '" << list << "'");
+
+		if (_cap_negotiating) {
+			ioSendRaw("CAP END");
+			_cap_negotiating = false;
+		}
+	} else if (subcommand == "NEW") {
+		// cap-notify, implied by 302
+		const uint32_t added = capBits(list);
+		_caps_offered |= added;
+		if (const uint32_t wanted = added & ~_caps.load(std::memory_order_relaxed); wanted != 0) {
+			requestCaps(wanted);
+		}
+	} else if (subcommand == "DEL") {
+		const uint32_t removed = capBits(list);
+		_caps_offered &= ~removed;
+		_caps.store(_caps.load(std::memory_order_relaxed) & ~removed, std::memory_order_relaxed);
+	}
 }
 
+void IRCClient1::requestCaps(uint32_t caps) {
+	std::string line {"CAP REQ :"};
+	for (size_t i = 0; i < cap_names.size(); i++) {
+		if ((caps & (1u << i)) != 0) {
+			if (line.back() != ':') {
+				line += ' ';
+			}
+			line += cap_names[i];
+		}
+	}
+	ioSendRaw(line);
+}
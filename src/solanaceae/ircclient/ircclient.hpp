@@ -3,9 +3,27 @@
 #include <solanaceae/util/config_model.hpp>
 #include <solanaceae/util/event_provider.hpp>
 
-#include <iostream> // tmp
+#include "./params.hpp"
+#include "./tags.hpp"
+#include "./isupport.hpp"
+#include "./poller.hpp"
+#include "./deadline_heap.hpp"
+#include "./spsc_ring.hpp"
+#include "./parser.hpp"
+#include "./log.hpp"
+
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <deque>
+#include <array>
+#include <algorithm>
+#include <optional>
 
 // fwd
+namespace IRCClient {
+	class Recorder;
+}
 struct irc_session_s;
 using irc_session_t = irc_session_s;
 extern "C" void* irc_get_ctx(irc_session_t* session);
@@ -17,97 +35,125 @@ namespace IRCClient::Events {
 	struct Numeric {
 		unsigned int event;
 		std::string_view origin;
-		std::vector<std::string_view> params;
+		Params params;
+		Tags tags;
 	};
 
 	struct Connect {
 		std::string_view origin;
-		std::vector<std::string_view> params;
+		Params params;
+		Tags tags;
 	};
 
 	struct Nick {
 		std::string_view origin;
-		std::vector<std::string_view> params;
+		Params params;
+		Tags tags;
 	};
 
 	struct Quit {
 		std::string_view origin;
-		std::vector<std::string_view> params;
+		Params params;
+		Tags tags;
 	};
 
 	struct Join {
 		std::string_view origin;
-		std::vector<std::string_view> params;
+		Params params;
+		Tags tags;
 	};
 
 	struct Part {
 		std::string_view origin;
-		std::vector<std::string_view> params;
+		Params params;
+		Tags tags;
 	};
 
 	struct Mode {
 		std::string_view origin;
-		std::vector<std::string_view> params;
+		Params params;
+		Tags tags;
 	};
 
 	struct UMode {
 		std::string_view origin;
-		std::vector<std::string_view> params;
+		Params params;
+		Tags tags;
 	};
 
 	struct Topic {
 		std::string_view origin;
-		std::vector<std::string_view> params;
+		Params params;
+		Tags tags;
 	};
 
 	struct Kick {
 		std::string_view origin;
-		std::vector<std::string_view> params;
+		Params params;
+		Tags tags;
 	};
 
 	struct Channel {
 		std::string_view origin;
-		std::vector<std::string_view> params;
+		Params params;
+		Tags tags;
 	};
 
 	struct PrivMSG {
 		std::string_view origin;
-		std::vector<std::string_view> params;
+		Params params;
+		Tags tags;
 	};
 
 	struct Notice {
 		std::string_view origin;
-		std::vector<std::string_view> params;
+		Params params;
+		Tags tags;
 	};
 
 	struct ChannelNotice {
 		std::string_view origin;
-		std::vector<std::string_view> params;
+		Params params;
+		Tags tags;
 	};
 
 	struct Invite {
 		std::string_view origin;
-		std::vector<std::string_view> params;
+		Params params;
+		Tags tags;
 	};
 
 	struct CTCP_Req {
 		std::string_view origin;
-		std::vector<std::string_view> params;
+		Params params;
+		Tags tags;
 	};
 
 	struct CTCP_Rep {
 		std::string_view origin;
-		std::vector<std::string_view> params;
+		Params params;
+		Tags tags;
 	};
 
 	struct CTCP_Action {
 		std::string_view origin;
-		std::vector<std::string_view> params;
+		Params params;
+		Tags tags;
 	};
 
 	struct Unknown {
 		std::string_view origin;
-		std::vector<std::string_view> params;
+		Params params;
+		Tags tags;
+	};
+
+	// ircv3 batch start or end, native transport only
+	// params.front() is "+<ref>" (start, followed by type and args) or "-<ref>" (end)
+	// events in between carry a "batch=<ref>" tag
+	struct Batch {
+		std::string_view origin;
+		Params params;
+		Tags tags;
 	};
 
 	struct Disconnect {
@@ -115,8 +161,37 @@ namespace IRCClient::Events {
 		// this is not a libircclient event (bad lib)
 	};
 
+	// after a round of events was dispatched (end of iterate), not fired if there were none
+	// for deferring work that many events would repeat, eg. contact store updates
+	struct DispatchDone {
+	};
+
 } // Events
 
+namespace IRCClient {
+
+	// outgoing queue order, higher priority lines always go first
+	enum class SendPriority : uint8_t {
+		interactive, // messages typed by the user
+		normal,
+		bulk, // join, who and other automated traffic
+
+		MAX
+	};
+
+	// ircv3 capabilities we make use of, see IRCClient1::hasCap()
+	enum class Cap : uint8_t {
+		message_tags,
+		server_time,
+		batch,
+		multi_prefix,
+		userhost_in_names,
+
+		MAX
+	};
+
+} // IRCClient
+
 enum class IRCClient_Event : uint32_t {
 	NUMERIC,
 	CONNECT,
@@ -142,6 +217,10 @@ enum class IRCClient_Event : uint32_t {
 
 	DISCONNECT,
 
+	BATCH,
+
+	DISPATCH_DONE,
+
 	MAX
 };
 
@@ -170,25 +249,143 @@ struct IRCClientEventI {
 	virtual bool onEvent(const IRCClient::Events::CTCP_Action&) { return false; }
 	virtual bool onEvent(const IRCClient::Events::Unknown&) { return false; }
 	virtual bool onEvent(const IRCClient::Events::Disconnect&) { return false; }
+	virtual bool onEvent(const IRCClient::Events::Batch&) { return false; }
+	virtual bool onEvent(const IRCClient::Events::DispatchDone&) { return false; }
 };
 
 using IRCClientEventProviderI = EventProviderI<IRCClientEventI>;
 
-// one network per instance only
+// one network per instance only, see IRCClientPool for many
 class IRCClient1 : public IRCClientEventProviderI {
 	ConfigModelI& _conf;
+	std::string _config_section {"IRCClient"};
 
 	irc_session_t* _irc_session {nullptr};
 	bool _try_connecting_state {false};
-	float _try_connecting_cooldown {0.f};
 
-	bool _event_fired {false};
+	bool _event_fired {false}; // main side, since the last DispatchDone
+
+	IRCClient::ISupport _isupport; // main side, from RPL_ISUPPORT, reset on RPL_WELCOME
+
+	enum class Deadline : uint8_t {
+		reconnect,
+		ping, // send a keepalive ping, if the connection was idle
+		ping_timeout, // nothing came back, the connection is dead
+		flood_release, // enough penalty drained to send the next queued line
+
+		MAX
+	};
+	using Clock = IRCClient::DeadlineHeap<Deadline>::Clock;
+	IRCClient::DeadlineHeap<Deadline> _deadlines;
+
+	Clock::time_point _last_activity {}; // last time we read from the socket
+	Clock::time_point _ping_sent {};
+
+	// from config
+	std::chrono::seconds _reconnect_interval {20};
+	std::chrono::seconds _ping_interval {120};
+	std::chrono::seconds _ping_timeout {60};
+	bool _flood_control {true};
+	std::chrono::milliseconds _flood_penalty {2000};
+	std::chrono::milliseconds _flood_window {10000};
+	// upper bound for iterate, we cant wake the host on socket activity
+	// 1s like before the deadline heap, lower it (max_wait_ms) to trade idle wakeups for latency
+	float _max_wait {1.f};
+
+	// readiness of the session socket, latched from edge triggered events
+	// the poller might be shared with other clients (pool)
+	IRCClientPoller* _poller {nullptr};
+	std::unique_ptr<IRCClientPoller> _own_poller;
+	bool _external_io {false}; // the pool runs our io
+	IRCClientPoller::NativeSocket _sock {IRCClientPoller::invalid_socket};
+	bool _sock_readable {false};
+	bool _sock_writable {false};
+	bool _pending_write {false}; // we handed libircclient something to send
+
+	// who reads and parses the socket
+	// native only does plaintext, ssl servers always go through libircclient
+	enum class Transport : uint8_t {
+		libircclient,
+		native, // own socket and parser, see parser.hpp
+		replay, // no network, lines come in through feedLine(), sends are dropped
+	};
+	Transport _transport {Transport::libircclient};
+	bool _ssl {false}; // libircclient over ssl, openssl buffers records behind the socket
+	uint64_t _io_events {0}; // events emitted by the io side, to tell if a read made progress
+
+	// native transport state, io side
+	IRCClient::LineBuffer _recv_buffer;
+	std::string _send_buffer; // unsent bytes
+	bool _native_connecting {false}; // tcp connect in flight
+	bool _motd_received {false}; // connect event fired
+	std::string _current_nick; // what the server calls us, for routing privmsg/notice/mode
+
+	// ircv3 capability negotiation, native transport only
+	bool _cap_negotiation {true}; // from config
+	bool _cap_negotiating {false}; // registration is on hold until CAP END
+	uint32_t _caps_offered {0}; // bits of IRCClient::Cap
+	std::atomic_uint32_t _caps {0}; // acknowledged, read by the main thread
+
+	// raw wire traffic, native transport only, see recorder.hpp
+	std::unique_ptr<IRCClient::Recorder> _recorder;
+
+	// outgoing lines, io side
+	// paced with rfc 1459 8.10 style flood control:
+	// every line pushes the flood timer forward by a penalty,
+	// lines are only released while the timer is less than the window ahead of now
+	std::array<std::deque<std::string>, static_cast<size_t>(IRCClient::SendPriority::MAX)> _send_queues;
+	Clock::time_point _flood_timer {};
+	bool _registered {false}; // 001 seen, the queues are held until then (registration lines bypass them)
+	std::atomic_size_t _send_queue_depth {0};
+	std::atomic_bool _io_connected {false}; // mirror for the main thread
+
+	// threaded mode:
+	// the io thread owns the session and hands events over as owned records,
+	// which are dispatched on the main thread in iterate
+	// outgoing lines take the opposite way
+	struct EventRecord {
+		IRCClient_Event type {IRCClient_Event::MAX};
+		unsigned int numeric {0};
+		bool has_origin {false};
+		size_t tags_size {0};
+		std::string data; // tags, origin and all params, back to back
+		std::vector<size_t> sizes; // origin first
+	};
+	struct SendRecord {
+		IRCClient::SendPriority priority {IRCClient::SendPriority::normal};
+		std::string line;
+	};
+	bool _threaded {false};
+	std::unique_ptr<IRCClient::SPSCRing<EventRecord>> _event_ring; // io -> main
+	std::unique_ptr<IRCClient::SPSCRing<SendRecord>> _send_ring; // main -> io
+	std::thread _io_thread;
+	std::atomic_bool _io_stop {false};
 
 	std::string _server_name; // name of the irc network this iirc is connected to
 
+	// connection parameters, read once, so the io thread never touches the config
+	std::string _server; // if prefixed with '#', its ssl
+	uint16_t _port {6660};
+	std::string _nick;
+	std::string _username;
+	std::string _realname;
+
+	friend class IRCClientPool;
+
 	public:
+		// reads its settings from config_section
 		IRCClient1(
-			ConfigModelI& conf
+			ConfigModelI& conf,
+			std::string_view config_section = "IRCClient"
+		);
+
+		// io is driven externally on poller (see IRCClientPool)
+		// in threaded mode, iterate on the main thread only dispatches
+		IRCClient1(
+			ConfigModelI& conf,
+			std::string_view config_section,
+			IRCClientPoller& poller,
+			bool threaded
 		);
 
 		~IRCClient1(void);
@@ -196,51 +393,158 @@ class IRCClient1 : public IRCClientEventProviderI {
 
 		// tmp
 		void run(void);
+
+		// returns the time until the next deadline (capped),
+		// or 0 if there is still data buffered on the socket
+		// in threaded mode, only dispatches the events the io thread queued up
 		float iterate(float delta);
 
 		// raw access
+		// not safe to use in threaded mode, use the send functions instead
+		// unused with the native transport
 		irc_session_t* getSession(void);
 
 		const std::string_view getServerName(void) const;
+		const std::string& getConfigSection(void) const;
 
-		// join
+		bool isThreaded(void) const;
+
+		// sending, all of these are safe to call from the main thread in threaded mode
+		// lines are queued and paced by flood control, returns false if not connected
+		// line without trailing crlf
+		bool sendRaw(std::string_view line, IRCClient::SendPriority priority = IRCClient::SendPriority::normal);
+		bool sendMessage(std::string_view target, std::string_view text);
+		bool sendAction(std::string_view target, std::string_view text);
+
+		// join, bulk priority
 		void join(std::string_view channel);
 
+		// true once the server acknowledged the capability, reset on reconnect
+		// always false with the libircclient transport
+		bool hasCap(IRCClient::Cap cap) const;
+
+		// the servers limits and modes, main side
+		// complete by the Connect event, updated before the Numeric event of each 005
+		const IRCClient::ISupport& getISupport(void) const;
+
+		// hands a line (without crlf) to the parser, as if it was received
+		// for the replay transport, not in threaded mode
+		void feedLine(std::string_view line);
+
+		// lines queued but not yet handed to the socket
+		// use for backpressure, eg. stop pasting while this is high
+		size_t getSendQueueDepth(void) const;
+
 	private:
+		void init(bool threaded);
+
+		// one round of io, runs on the io thread in threaded mode
+		// returns the time until the next deadline (capped)
+		float ioStep(int timeout_ms);
+		void ioThreadMain(void);
+
+		// the parts of ioStep, so a shared poller can drive many clients
+		void ioPrepare(void);
+		bool ioWantsImmediate(void) const;
+		void ioLatch(const IRCClientPoller::Event& ev);
+		float ioProcess(void);
+
+		// io side, sends directly, bypassing the queue
+		bool ioSendRaw(const std::string& line);
+		void ioEnqueue(IRCClient::SendPriority priority, std::string&& line);
+		void flushSendRing(void);
+		// releases queued lines as far as flood control allows
+		void releaseQueued(Clock::time_point now);
+		void updateSendQueueDepth(void);
+
+		// main side, threaded mode
+		float drainEvents(void);
+		void dispatchRecord(const EventRecord& rec);
+
+		// io side, threaded mode, blocks while the ring is full
+		void pushEvent(IRCClient_Event type, unsigned int numeric, std::optional<std::string_view> origin, IRCClient::Params params, IRCClient::Tags tags);
+
+		// io side, pushes in threaded mode, dispatches otherwise
+		void emitEvent(IRCClient_Event type, unsigned int numeric, std::optional<std::string_view> origin, IRCClient::Params params, IRCClient::Tags tags = {});
+
+		// main side, no origin gets replaced with a placeholder
+		void dispatchEvent(IRCClient_Event type, unsigned int numeric, std::optional<std::string_view> origin, IRCClient::Params params, IRCClient::Tags tags);
+
+		// main side, fires DispatchDone if anything was dispatched since the last one
+		void dispatchDone(void);
+
+		// PRIVMSG text that still fits the line once the server relays it with our prefix
+		// extra is what the text gets wrapped in (eg. ctcp)
+		size_t maxTextLength(std::string_view target, size_t extra) const;
+		// splits at spaces (or utf-8 boundaries) into lines of at most max_length
+		template<typename FN>
+		static bool splitText(std::string_view text, size_t max_length, FN&& fn);
+
+		// irc_is_connected() equivalent for both transports (includes connecting)
+		bool ioIsConnected(void) const;
+
 		// connects an already existing session
 		void connectSession(void);
 
+		// closes the socket, the next iterate notices and reconnects
+		void closeSession(void);
+
+		void handleDeadlines(Clock::time_point now);
+
+		// (re)registers the current session socket with the poller
+		void registerSocket(void);
+
+		// non blocking, drains the latched socket readiness
+		void processSocket(void);
+
+	private: // native transport
+		// false if it failed right away
+		bool connectNative(void);
+		void processSocketNative(void);
+		bool flushSendBuffer(void);
+
+		// maps a line to events, like libircclient does (nicks are stripped)
+		void dispatchLine(std::string_view line);
+		void dispatchMessage(const IRCClient::Message& msg);
+
+		// CAP LS/ACK/NAK/NEW/DEL
+		void handleCap(IRCClient::Params params);
+		void requestCaps(uint32_t caps);
+
 	private: // callbacks for libircclient
 		static void on_event_numeric(irc_session_t* session, unsigned int event, const char* origin, const char** params, unsigned int count);
 
-		template<IRCClient_Event event_type_enum, typename EventType>
+		template<IRCClient_Event event_type_enum>
 		static void on_event_generic_new(irc_session_t* session, const char* event, const char* origin, const char** params, unsigned int count) {
 			assert(session != nullptr);
 
-			std::vector<std::string_view> params_view;
-			for (size_t i = 0; i < count; i++) {
-				params_view.push_back(params[i]);
+			// no allocation, the events only carry a view of this
+			std::array<std::string_view, IRCClient::max_params> params_array;
+			const size_t params_count = std::min<size_t>(count, params_array.size());
+			if (params_count < count) {
+				IRCC_LOG_WARN("IRCC warning: event '" << event << "' has " << count << " params, dropping all past " << params_count);
 			}
-
-			std::cout << "IRC: event '" << (event?event:"<nullptr>") << "' o:" << (origin?origin:"<nullptr>") << "\n";
-
-#if 0
-			if (std::string_view{event} == "ACTION") {
-				std::cout << " -action is " << typeid(EventType).name() << "\n";
-				std::cout << " -enum is " << (int)event_type_enum << "\n";
+			for (size_t i = 0; i < params_count; i++) {
+				params_array[i] = params[i];
 			}
-#endif
-
-			for (const auto it : params_view) {
-				std::cout << "  " << it << "\n";
+			const IRCClient::Params params_view{params_array.data(), params_count};
+
+			if (IRCC_LOG_ENABLED(IRCClient::Log::Level::trace)) {
+				IRCClient::Log::Line line{IRCClient::Log::Level::trace};
+				line << "IRC: event '" << event << "' o:" << origin;
+				for (const auto it : params_view) {
+					line << " '" << it << "'";
+				}
 			}
 
 			auto* ircc = static_cast<IRCClient1*>(irc_get_ctx(session));
 			assert(ircc != nullptr);
 
-			// hack if origin is null
-			ircc->dispatch(event_type_enum, EventType{origin?origin:"<nullptr>", params_view});
-			ircc->_event_fired = true;
+			ircc->emitEvent(
+				event_type_enum, 0,
+				origin != nullptr ? std::optional<std::string_view>{origin} : std::nullopt,
+				params_view
+			);
 		}
 };
 
@@ -0,0 +1,136 @@
+#include "./ircclient_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+IRCClientPool::IRCClientPool(ConfigModelI& conf) : _conf(conf) {
+	for (const auto& [network, enabled] : _conf.entries_bool("IRCClientPool", "networks")) {
+		if (enabled) {
+			_networks.push_back({std::string{network}, nullptr});
+		}
+	}
+
+	if (_networks.empty()) {
+		IRCC_LOG_WARN("IRCCP warning: no networks configured");
+	}
+
+	const size_t thread_count = std::min<size_t>(
+		static_cast<size_t>(std::max<int64_t>(_conf.get_int("IRCClientPool", "threads").value_or(0), 0)),
+		_networks.size()
+	);
+	for (size_t i = 0; i < thread_count; i++) {
+		_shards.push_back(std::make_unique<Shard>());
+	}
+
+	for (size_t i = 0; i < _networks.size(); i++) {
+		auto& network = _networks[i];
+		IRCC_LOG_INFO("IRCCP: adding network '" << network.name << "'");
+
+		if (_shards.empty()) {
+			network.client = std::make_unique<IRCClient1>(_conf, configSection(network.name), _poller, false);
+			_local_clients.push_back(network.client.get());
+		} else {
+			// round robin
+			auto& shard = *_shards[i % _shards.size()];
+			network.client = std::make_unique<IRCClient1>(_conf, configSection(network.name), shard.poller, true);
+			shard.clients.push_back(network.client.get());
+		}
+	}
+
+	// all clients exist, start the workers
+	for (auto& shard : _shards) {
+		shard->thread = std::thread(&IRCClientPool::workerMain, this, std::ref(*shard));
+	}
+}
+
+IRCClientPool::~IRCClientPool(void) {
+	_stop = true;
+	for (auto& shard : _shards) {
+		// a worker blocked on a full event ring only checks its clients stop flag
+		// (sharded clients have no io thread of their own to set it)
+		for (auto* client : shard->clients) {
+			client->_io_stop = true;
+		}
+		shard->poller.wake();
+		if (shard->thread.joinable()) {
+			shard->thread.join();
+		}
+	}
+
+	// clients unregister from the pollers, so they go first
+	_networks.clear();
+}
+
+float IRCClientPool::iterate(float delta) {
+	float wait = step(_poller, _local_clients, 0);
+	for (auto* client : _local_clients) {
+		client->dispatchDone();
+	}
+
+	// sharded clients are threaded, this just drains their events
+	for (auto& shard : _shards) {
+		for (auto* client : shard->clients) {
+			wait = std::min(wait, client->iterate(delta));
+		}
+	}
+
+	return wait;
+}
+
+size_t IRCClientPool::size(void) const {
+	return _networks.size();
+}
+
+std::string_view IRCClientPool::getNetworkName(size_t i) const {
+	return _networks.at(i).name;
+}
+
+IRCClient1& IRCClientPool::getClient(size_t i) {
+	return *_networks.at(i).client;
+}
+
+IRCClient1* IRCClientPool::findClient(std::string_view network) {
+	for (auto& it : _networks) {
+		if (it.name == network) {
+			return it.client.get();
+		}
+	}
+	return nullptr;
+}
+
+std::string IRCClientPool::configSection(std::string_view network) {
+	std::string section{"IRCClient/"};
+	section += network;
+	return section;
+}
+
+float IRCClientPool::step(IRCClientPoller& poller, const std::vector<IRCClient1*>& clients, int timeout_ms) {
+	if (clients.empty()) {
+		return 1.f;
+	}
+
+	bool immediate {false};
+	for (auto* client : clients) {
+		client->ioPrepare();
+		immediate = immediate || client->ioWantsImmediate();
+	}
+
+	// one wait for all of them
+	for (const auto& ev : poller.wait(immediate ? 0 : timeout_ms)) {
+		static_cast<IRCClient1*>(ev.user)->ioLatch(ev);
+	}
+
+	float wait = std::numeric_limits<float>::max();
+	for (auto* client : clients) {
+		wait = std::min(wait, client->ioProcess());
+	}
+	return wait;
+}
+
+void IRCClientPool::workerMain(Shard& shard) {
+	float wait {0.f};
+	while (!_stop.load(std::memory_order_relaxed)) {
+		wait = step(shard.poller, shard.clients, static_cast<int>(std::ceil(wait * 1000.f)));
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "./ircclient.hpp"
+
+#include <solanaceae/util/config_model.hpp>
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <thread>
+#include <atomic>
+
+// many networks, one readiness loop
+//
+// config:
+// IRCClientPool.networks : bool entries, one per network name
+// IRCClientPool.threads : number of io worker threads, 0 (default) runs all io inside iterate
+// each network reads its settings from the "IRCClient/<network>" section,
+// with the same keys as a standalone IRCClient1
+class IRCClientPool {
+	ConfigModelI& _conf;
+
+	// unsharded, all clients on one poller, polled in iterate
+	IRCClientPoller _poller;
+	std::vector<IRCClient1*> _local_clients;
+
+	// sharded, each worker owns a poller and a subset of the clients
+	struct Shard {
+		IRCClientPoller poller;
+		std::vector<IRCClient1*> clients;
+		std::thread thread;
+	};
+	std::vector<std::unique_ptr<Shard>> _shards;
+	std::atomic_bool _stop {false};
+
+	struct Network {
+		std::string name;
+		std::unique_ptr<IRCClient1> client;
+	};
+	std::vector<Network> _networks;
+
+	public:
+		IRCClientPool(ConfigModelI& conf);
+		~IRCClientPool(void);
+
+		// runs io for all unsharded networks, dispatches events of all networks
+		float iterate(float delta);
+
+		size_t size(void) const;
+		std::string_view getNetworkName(size_t i) const;
+		IRCClient1& getClient(size_t i);
+
+		// nullptr if unknown
+		IRCClient1* findClient(std::string_view network);
+
+		static std::string configSection(std::string_view network);
+
+	private:
+		// one round on a poller for a set of clients
+		static float step(IRCClientPoller& poller, const std::vector<IRCClient1*>& clients, int timeout_ms);
+		void workerMain(Shard& shard);
+};
+
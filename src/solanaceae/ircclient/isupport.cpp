@@ -0,0 +1,162 @@
+#include "./isupport.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <optional>
+
+namespace IRCClient {
+
+namespace {
+
+std::optional<size_t> parseSize(std::string_view value) {
+	size_t res {0};
+	const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), res);
+	if (ec != std::errc{} || ptr != value.data() + value.size()) {
+		return std::nullopt;
+	}
+	return res;
+}
+
+// calls fn(key, value) for "key:value,key2:,key3:value3"
+template<typename FN>
+void eachPair(std::string_view list, FN&& fn) {
+	while (!list.empty()) {
+		const auto comma = list.find(',');
+		const auto entry = list.substr(0, comma);
+		list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma+1);
+
+		const auto colon = entry.find(':');
+		if (colon == std::string_view::npos || colon == 0) {
+			continue;
+		}
+		fn(entry.substr(0, colon), entry.substr(colon+1));
+	}
+}
+
+std::optional<ISupport::Target> targetFromCommand(std::string_view command) {
+	if (command == "JOIN") { return ISupport::Target::join; }
+	if (command == "PART") { return ISupport::Target::part; }
+	if (command == "PRIVMSG") { return ISupport::Target::privmsg; }
+	if (command == "NOTICE") { return ISupport::Target::notice; }
+	if (command == "KICK") { return ISupport::Target::kick; }
+	if (command == "NAMES") { return ISupport::Target::names; }
+	if (command == "WHOIS") { return ISupport::Target::whois; }
+	return std::nullopt;
+}
+
+} // anonymous
+
+ISupport::ISupport(void) {
+	reset();
+}
+
+void ISupport::reset(void) {
+	for (const auto key : {"CASEMAPPING", "CHANTYPES", "PREFIX", "CHANMODES", "NICKLEN", "USERLEN", "LINELEN", "TARGMAX", "CHANLIMIT", "MONITOR", "WHOX"}) {
+		resetToken(key);
+	}
+}
+
+void ISupport::resetToken(std::string_view key) {
+	if (key == "CASEMAPPING") {
+		_casemapping = CaseMapping::rfc1459;
+	} else if (key == "CHANTYPES") {
+		_chantypes.fill(false);
+		for (const char c : std::string_view{"#&+!"}) {
+			_chantypes[static_cast<unsigned char>(c)] = true;
+		}
+	} else if (key == "PREFIX") {
+		_channel_modes.parsePrefix("(ov)@+");
+	} else if (key == "CHANMODES") {
+		_channel_modes.parseChanModes("beI,k,l,imnpst");
+	} else if (key == "NICKLEN") {
+		_nicklen = 9;
+	} else if (key == "USERLEN") {
+		_userlen = 10;
+	} else if (key == "LINELEN") {
+		_linelen = 512;
+	} else if (key == "TARGMAX" || key == "MAXTARGETS") {
+		// guesses, joins are commonly fine with a few channels per line
+		_targmax.fill(1);
+		_targmax[static_cast<size_t>(Target::join)] = 8;
+	} else if (key == "CHANLIMIT") {
+		_chanlimits.clear();
+	} else if (key == "MONITOR") {
+		_has_monitor = false;
+		_monitor = 0;
+	} else if (key == "WHOX") {
+		_whox = false;
+	}
+}
+
+void ISupport::parseToken(std::string_view token) {
+	if (token.empty()) {
+		return;
+	}
+
+	if (token.front() == '-') {
+		// negated, back to the default
+		resetToken(token.substr(1));
+		return;
+	}
+
+	const auto eq = token.find('=');
+	const auto key = token.substr(0, eq);
+	const auto value = eq == std::string_view::npos ? std::string_view{} : token.substr(eq+1);
+
+	if (key == "CASEMAPPING") {
+		if (value == "ascii") {
+			_casemapping = CaseMapping::ascii;
+		} else if (value == "strict-rfc1459") {
+			_casemapping = CaseMapping::strict_rfc1459;
+		} else if (value == "rfc7613" || value == "rfc8265") {
+			_casemapping = CaseMapping::rfc7613;
+		} else {
+			_casemapping = CaseMapping::rfc1459;
+		}
+	} else if (key == "CHANTYPES") {
+		// empty is no channels at all
+		_chantypes.fill(false);
+		for (const char c : value) {
+			if (static_cast<unsigned char>(c) < _chantypes.size()) {
+				_chantypes[static_cast<unsigned char>(c)] = true;
+			}
+		}
+	} else if (key == "PREFIX") {
+		_channel_modes.parsePrefix(value);
+	} else if (key == "CHANMODES") {
+		_channel_modes.parseChanModes(value);
+	} else if (key == "NICKLEN") {
+		_nicklen = parseSize(value).value_or(_nicklen);
+	} else if (key == "USERLEN") {
+		_userlen = parseSize(value).value_or(_userlen);
+	} else if (key == "LINELEN") {
+		_linelen = std::max<size_t>(512, parseSize(value).value_or(0));
+	} else if (key == "TARGMAX") {
+		// eg. "JOIN:,PRIVMSG:4", no number is no limit
+		// overrides MAXTARGETS
+		eachPair(value, [this](std::string_view command, std::string_view limit) {
+			if (const auto target = targetFromCommand(command); target.has_value()) {
+				_targmax[static_cast<size_t>(target.value())] = parseSize(limit).value_or(unlimited);
+			}
+		});
+	} else if (key == "MAXTARGETS") {
+		// old form of TARGMAX for PRIVMSG and NOTICE, servers send one or the other
+		const auto limit = parseSize(value).value_or(unlimited);
+		_targmax[static_cast<size_t>(Target::privmsg)] = limit;
+		_targmax[static_cast<size_t>(Target::notice)] = limit;
+	} else if (key == "CHANLIMIT") {
+		// eg. "#&:100,+:", no number is no limit
+		_chanlimits.clear();
+		eachPair(value, [this](std::string_view prefixes, std::string_view limit) {
+			_chanlimits.emplace_back(std::string{prefixes}, parseSize(limit).value_or(unlimited));
+		});
+	} else if (key == "MONITOR") {
+		_has_monitor = true;
+		_monitor = parseSize(value).value_or(unlimited);
+	} else if (key == "WHOX") {
+		_whox = true;
+	}
+}
+
+} // IRCClient
+
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "./channel_modes.hpp"
+#include "./casefold.hpp"
+
+#include <array>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <cstdint>
+
+namespace IRCClient {
+
+	// what the server advertised in RPL_ISUPPORT (005), parsed once per token
+	// so the queries are plain member reads or table lookups
+	// unadvertised values are the rfc defaults, or conservative guesses where there is none
+	class ISupport {
+		public:
+			using CaseMapping = ::IRCClient::CaseMapping;
+
+			// commands we care about for TARGMAX
+			enum class Target : uint8_t {
+				join,
+				part,
+				privmsg,
+				notice,
+				kick,
+				names,
+				whois,
+
+				MAX
+			};
+
+			static constexpr size_t unlimited {0};
+
+		private:
+			CaseMapping _casemapping {CaseMapping::rfc1459};
+			std::array<bool, 128> _chantypes {};
+			ChannelModes _channel_modes;
+			size_t _nicklen {9};
+			size_t _userlen {10};
+			size_t _linelen {512};
+			std::array<size_t, static_cast<size_t>(Target::MAX)> _targmax {};
+			std::vector<std::pair<std::string, size_t>> _chanlimits; // prefixes -> limit
+			size_t _monitor {0}; // limit, 0 is not supported
+			bool _has_monitor {false};
+			bool _whox {false};
+
+		public:
+			ISupport(void);
+
+			// new connection, everything back to the defaults
+			void reset(void);
+
+			// one token, eg. "CHANTYPES=#&", "-WHOX" or "WHOX"
+			void parseToken(std::string_view token);
+
+			CaseMapping casemapping(void) const { return _casemapping; }
+
+			// nick and channel names folded by CASEMAPPING, for keys and comparisons
+			void foldInto(std::string_view name, std::string& out) const { ::IRCClient::foldInto(_casemapping, name, out); }
+			std::string fold(std::string_view name) const { return ::IRCClient::fold(_casemapping, name); }
+			bool equalFold(std::string_view a, std::string_view b) const { return ::IRCClient::equalFold(_casemapping, a, b); }
+
+			bool isChannelName(std::string_view name) const {
+				if (name.empty()) {
+					return false;
+				}
+				const auto i = static_cast<unsigned char>(name.front());
+				return i < _chantypes.size() && _chantypes[i];
+			}
+
+			// PREFIX and CHANMODES
+			const ChannelModes& channelModes(void) const { return _channel_modes; }
+
+			size_t nickLen(void) const { return _nicklen; }
+			size_t userLen(void) const { return _userlen; }
+			// including crlf, never below 512
+			size_t lineLen(void) const { return _linelen; }
+
+			// max targets per command, unlimited (0) if advertised without a number
+			size_t targMax(Target target) const { return _targmax[static_cast<size_t>(target)]; }
+
+			// channel type prefixes -> max channels of these types we can be in (together)
+			// unlimited (0) if advertised without a number, types not listed have no limit
+			const std::vector<std::pair<std::string, size_t>>& chanLimits(void) const { return _chanlimits; }
+
+			bool hasMonitor(void) const { return _has_monitor; }
+			// unlimited (0) if advertised without a number
+			size_t monitorLimit(void) const { return _monitor; }
+
+			bool hasWhoX(void) const { return _whox; }
+
+		private:
+			void resetToken(std::string_view key);
+	};
+
+} // IRCClient
+
@@ -0,0 +1,190 @@
+#include "./log.hpp"
+
+#include <memory>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+namespace IRCClient::Log {
+
+std::atomic<uint8_t> g_runtime_level {static_cast<uint8_t>(Level::info)};
+
+namespace {
+
+struct Slot {
+	std::atomic<size_t> seq {0};
+	Level level {Level::info};
+	size_t size {0};
+	char text[Line::max_size];
+};
+
+// bounded multi producer single consumer ring (vyukov style sequence numbers)
+// producers never block, if the ring is full the line is dropped and counted
+class Logger {
+	static constexpr size_t capacity {1024}; // pow2
+	static constexpr size_t mask {capacity-1};
+
+	std::unique_ptr<Slot[]> _slots {new Slot[capacity]};
+
+	alignas(64) std::atomic<size_t> _enqueue_pos {0};
+	alignas(64) size_t _dequeue_pos {0}; // only touched by the writer thread
+
+	std::atomic_size_t _dropped {0};
+
+	// only used to park the writer thread, producers just notify
+	std::mutex _mutex;
+	std::condition_variable _cv;
+	std::atomic_bool _writer_sleeping {false};
+	std::atomic_bool _stop {false};
+
+	// flush() waits for the writer to pass this position
+	std::atomic<size_t> _written_pos {0};
+
+	std::thread _thread;
+
+	public:
+		Logger(void) {
+			for (size_t i = 0; i < capacity; i++) {
+				_slots[i].seq.store(i, std::memory_order_relaxed);
+			}
+			_thread = std::thread([this](void) { writerMain(); });
+		}
+
+		~Logger(void) {
+			_stop = true;
+			_cv.notify_one();
+			if (_thread.joinable()) {
+				_thread.join();
+			}
+		}
+
+		void push(Level level, const char* text, size_t size) {
+			size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+			Slot* slot {nullptr};
+			for (;;) {
+				slot = &_slots[pos & mask];
+				const size_t seq = slot->seq.load(std::memory_order_acquire);
+				const auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+				if (diff == 0) {
+					if (_enqueue_pos.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed)) {
+						break;
+					}
+				} else if (diff < 0) {
+					_dropped.fetch_add(1, std::memory_order_relaxed);
+					return;
+				} else {
+					pos = _enqueue_pos.load(std::memory_order_relaxed);
+				}
+			}
+
+			slot->level = level;
+			slot->size = size;
+			std::copy(text, text + size, slot->text);
+			slot->seq.store(pos+1, std::memory_order_release);
+
+			// a missed wakeup only delays the line until the writers wait times out
+			if (_writer_sleeping.load(std::memory_order_acquire)) {
+				_cv.notify_one();
+			}
+		}
+
+		void flush(void) {
+			const size_t target = _enqueue_pos.load(std::memory_order_acquire);
+			while (_written_pos.load(std::memory_order_acquire) < target && !_stop) {
+				_cv.notify_one();
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+
+	private:
+		// returns the number of lines written
+		size_t drain(void) {
+			size_t count {0};
+			bool had_err {false};
+			bool had_out {false};
+
+			for (;;) {
+				Slot& slot = _slots[_dequeue_pos & mask];
+				if (slot.seq.load(std::memory_order_acquire) != _dequeue_pos+1) {
+					break; // empty (or next slot not yet committed)
+				}
+
+				// keep the old split, errors and warnings go to cerr
+				std::ostream& os = slot.level >= Level::warn ? std::cerr : std::cout;
+				os.write(slot.text, static_cast<std::streamsize>(slot.size));
+				os.put('\n');
+				(slot.level >= Level::warn ? had_err : had_out) = true;
+
+				slot.seq.store(_dequeue_pos + capacity, std::memory_order_release);
+				_dequeue_pos++;
+				count++;
+			}
+
+			if (const size_t dropped = _dropped.exchange(0, std::memory_order_relaxed); dropped > 0) {
+				std::cerr << "IRCC log: dropped " << dropped << " lines\n";
+				had_err = true;
+			}
+
+			if (had_out) {
+				std::cout.flush();
+			}
+			if (had_err) {
+				std::cerr.flush();
+			}
+
+			_written_pos.store(_dequeue_pos, std::memory_order_release);
+
+			return count;
+		}
+
+		void writerMain(void) {
+			while (!_stop) {
+				if (drain() > 0) {
+					continue;
+				}
+
+				std::unique_lock lock{_mutex};
+				_writer_sleeping.store(true, std::memory_order_release);
+				// timeout only matters for the lost wakeup race in push()
+				_cv.wait_for(lock, std::chrono::milliseconds(500), [this](void) {
+					return _stop.load() || _slots[_dequeue_pos & mask].seq.load(std::memory_order_acquire) == _dequeue_pos+1;
+				});
+				_writer_sleeping.store(false, std::memory_order_relaxed);
+			}
+
+			drain(); // whatever was logged during shutdown
+		}
+};
+
+Logger& getLogger(void) {
+	static Logger logger;
+	return logger;
+}
+
+} // anonymous
+
+void flush(void) {
+	getLogger().flush();
+}
+
+Line::~Line(void) {
+	getLogger().push(_level, _buf.data(), _size);
+}
+
+Line& Line::operator<<(double value) {
+	if (_size >= max_size) {
+		return *this;
+	}
+	const int ret = std::snprintf(_buf.data() + _size, max_size - _size, "%g", value);
+	if (ret > 0) {
+		_size += static_cast<size_t>(ret) < max_size - _size ? static_cast<size_t>(ret) : max_size - _size - 1;
+	}
+	return *this;
+}
+
+} // IRCClient::Log
+
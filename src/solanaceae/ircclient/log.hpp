@@ -0,0 +1,149 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <type_traits>
+#include <cstdint>
+#include <cstddef>
+
+// leveled logging for the ircclient libs
+//
+// IRCC_LOG_DEBUG("joined " << channel << " users:" << count);
+//
+// - calls below SOLANACEAE_IRCCLIENT_LOG_MIN_LEVEL are compiled out entirely
+// - calls below the runtime level only cost a relaxed atomic load
+// - enabled calls format into a stack buffer and push it into a lock-free ring,
+//   a background thread does the actual (blocking) stream io
+//
+// lines are truncated to Line::max_size
+
+namespace IRCClient::Log {
+
+	enum class Level : uint8_t {
+		trace,
+		debug,
+		info,
+		warn,
+		error,
+		off,
+	};
+
+} // IRCClient::Log
+
+#if !defined(SOLANACEAE_IRCCLIENT_LOG_MIN_LEVEL)
+	#if defined(NDEBUG)
+		#define SOLANACEAE_IRCCLIENT_LOG_MIN_LEVEL 2 // info
+	#else
+		#define SOLANACEAE_IRCCLIENT_LOG_MIN_LEVEL 0 // trace
+	#endif
+#endif
+
+namespace IRCClient::Log {
+
+	// calls below are not compiled in
+	static constexpr int min_level {SOLANACEAE_IRCCLIENT_LOG_MIN_LEVEL};
+
+	constexpr bool compiledIn(Level level) {
+		return static_cast<int>(level) >= min_level;
+	}
+
+	// defaults to info
+	extern std::atomic<uint8_t> g_runtime_level;
+
+	inline void setLevel(Level level) {
+		g_runtime_level.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+	}
+
+	inline bool enabled(Level level) {
+		return static_cast<uint8_t>(level) >= g_runtime_level.load(std::memory_order_relaxed);
+	}
+
+	// blocks until everything logged so far is written
+	void flush(void);
+
+	// formats one line on the stack, submits it on destruction
+	class Line {
+		public:
+			static constexpr size_t max_size {240};
+
+		private:
+			Level _level;
+			std::array<char, max_size> _buf;
+			size_t _size {0};
+
+		public:
+			explicit Line(Level level) : _level(level) {}
+			~Line(void);
+
+			Line(const Line&) = delete;
+			Line& operator=(const Line&) = delete;
+
+			Line& operator<<(std::string_view value) {
+				const size_t count = value.size() < max_size - _size ? value.size() : max_size - _size;
+				value.copy(_buf.data() + _size, count);
+				_size += count;
+				return *this;
+			}
+
+			Line& operator<<(const char* value) {
+				return *this << (value != nullptr ? std::string_view{value} : std::string_view{"<nullptr>"});
+			}
+
+			Line& operator<<(const std::string& value) {
+				return *this << std::string_view{value};
+			}
+
+			Line& operator<<(char value) {
+				if (_size < max_size) {
+					_buf[_size++] = value;
+				}
+				return *this;
+			}
+
+			Line& operator<<(bool value) {
+				return *this << (value ? std::string_view{"true"} : std::string_view{"false"});
+			}
+
+			template<typename T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool> && !std::is_same_v<T, char>, int> = 0>
+			Line& operator<<(T value) {
+				const auto res = std::to_chars(_buf.data() + _size, _buf.data() + max_size, value);
+				if (res.ec == std::errc{}) {
+					_size = static_cast<size_t>(res.ptr - _buf.data());
+				}
+				return *this;
+			}
+
+			template<typename T, std::enable_if_t<std::is_enum_v<T>, int> = 0>
+			Line& operator<<(T value) {
+				return *this << static_cast<std::underlying_type_t<T>>(value);
+			}
+
+			Line& operator<<(double value);
+	};
+
+} // IRCClient::Log
+
+// for log statements that need more than one expression (loops)
+// constant folds to false if stripped at compile time
+#define IRCC_LOG_ENABLED(level) \
+	(::IRCClient::Log::compiledIn(level) && ::IRCClient::Log::enabled(level))
+
+#define IRCC_LOG(level, expr) \
+	do { \
+		if constexpr (::IRCClient::Log::compiledIn(level)) { \
+			if (::IRCClient::Log::enabled(level)) { \
+				::IRCClient::Log::Line ircc_log_line_{level}; \
+				ircc_log_line_ << expr; \
+			} \
+		} \
+	} while (false)
+
+#define IRCC_LOG_TRACE(expr) IRCC_LOG(::IRCClient::Log::Level::trace, expr)
+#define IRCC_LOG_DEBUG(expr) IRCC_LOG(::IRCClient::Log::Level::debug, expr)
+#define IRCC_LOG_INFO(expr) IRCC_LOG(::IRCClient::Log::Level::info, expr)
+#define IRCC_LOG_WARN(expr) IRCC_LOG(::IRCClient::Log::Level::warn, expr)
+#define IRCC_LOG_ERROR(expr) IRCC_LOG(::IRCClient::Log::Level::error, expr)
+
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string_view>
+#include <stdexcept>
+#include <cstddef>
+
+namespace IRCClient {
+
+	// rfc 1459 2.3, a message has at most 15 params
+	static constexpr size_t max_params {15};
+
+	// non owning view over the params of an event
+	// the backing array lives on the stack of whoever dispatches the event,
+	// so dont keep it around past the onEvent() call (same as the string_views)
+	class Params {
+		const std::string_view* _data {nullptr};
+		size_t _size {0};
+
+		public:
+			constexpr Params(void) = default;
+			constexpr Params(const std::string_view* data, size_t size) : _data(data), _size(size) {}
+
+			constexpr size_t size(void) const { return _size; }
+			constexpr bool empty(void) const { return _size == 0; }
+
+			constexpr const std::string_view* begin(void) const { return _data; }
+			constexpr const std::string_view* end(void) const { return _data + _size; }
+
+			constexpr const std::string_view& operator[](size_t i) const { return _data[i]; }
+			const std::string_view& at(size_t i) const {
+				if (i >= _size) {
+					throw std::out_of_range("IRCClient::Params::at");
+				}
+				return _data[i];
+			}
+
+			constexpr const std::string_view& front(void) const { return _data[0]; }
+			constexpr const std::string_view& back(void) const { return _data[_size-1]; }
+	};
+
+} // IRCClient
+
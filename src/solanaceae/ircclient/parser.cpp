@@ -0,0 +1,164 @@
+#include "./parser.hpp"
+
+#include <cstring>
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <immintrin.h>
+	#define IRCC_PARSER_SSE2 1
+#endif
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+
+namespace IRCClient {
+
+namespace {
+
+inline unsigned int countTrailingZeros(uint32_t value) {
+#if defined(_MSC_VER)
+	unsigned long ret;
+	_BitScanForward(&ret, value);
+	return static_cast<unsigned int>(ret);
+#else
+	return static_cast<unsigned int>(__builtin_ctz(value));
+#endif
+}
+
+inline const char* findByteScalar(const char* begin, const char* end, char c) {
+	for (; begin < end; begin++) {
+		if (*begin == c) {
+			return begin;
+		}
+	}
+	return end;
+}
+
+// skips runs of spaces, servers are not supposed to send them, but some do
+inline const char* skipSpaces(const char* begin, const char* end) {
+	while (begin < end && *begin == ' ') {
+		begin++;
+	}
+	return begin;
+}
+
+} // anonymous
+
+const char* findByte(const char* begin, const char* end, char c) {
+#if defined(__AVX2__)
+	const __m256i needle32 = _mm256_set1_epi8(c);
+	while (end - begin >= 32) {
+		const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+		const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle32)));
+		if (mask != 0) {
+			return begin + countTrailingZeros(mask);
+		}
+		begin += 32;
+	}
+#endif
+
+#if defined(IRCC_PARSER_SSE2)
+	const __m128i needle16 = _mm_set1_epi8(c);
+	while (end - begin >= 16) {
+		const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+		const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle16)));
+		if (mask != 0) {
+			return begin + countTrailingZeros(mask);
+		}
+		begin += 16;
+	}
+#endif
+
+	return findByteScalar(begin, end, c);
+}
+
+bool parseMessage(std::string_view line, Message& msg) {
+	msg.tags = {};
+	msg.prefix = {};
+	msg.command = {};
+	msg.params_count = 0;
+
+	const char* it = line.data();
+	const char* const end = line.data() + line.size();
+
+	it = skipSpaces(it, end);
+
+	if (it < end && *it == '@') {
+		const char* tags_end = findByte(it, end, ' ');
+		msg.tags = {it + 1, static_cast<size_t>(tags_end - (it + 1))};
+		it = skipSpaces(tags_end, end);
+	}
+
+	if (it < end && *it == ':') {
+		const char* prefix_end = findByte(it, end, ' ');
+		msg.prefix = {it + 1, static_cast<size_t>(prefix_end - (it + 1))};
+		it = skipSpaces(prefix_end, end);
+	}
+
+	{
+		const char* command_end = findByte(it, end, ' ');
+		msg.command = {it, static_cast<size_t>(command_end - it)};
+		it = skipSpaces(command_end, end);
+	}
+
+	if (msg.command.empty()) {
+		return false;
+	}
+
+	while (it < end) {
+		if (*it == ':' || msg.params_count == max_params - 1) {
+			// trailing, takes the rest of the line, spaces included
+			// (if we ran out of slots, the remaining middles get folded into it)
+			if (*it == ':') {
+				it++;
+			}
+			msg.params_array[msg.params_count++] = {it, static_cast<size_t>(end - it)};
+			break;
+		}
+
+		const char* param_end = findByte(it, end, ' ');
+		msg.params_array[msg.params_count++] = {it, static_cast<size_t>(param_end - it)};
+		it = skipSpaces(param_end, end);
+	}
+
+	return true;
+}
+
+LineBuffer::LineBuffer(size_t max_line) : _max_line(max_line) {
+}
+
+char* LineBuffer::writable(size_t min_free) {
+	if (_begin > 0) {
+		// move the incomplete line to the front
+		const size_t remaining = _end - _begin;
+		if (remaining > 0) {
+			std::memmove(_buf.data(), _buf.data() + _begin, remaining);
+		}
+		_scan -= _begin;
+		_end = remaining;
+		_begin = 0;
+	}
+
+	if (_buf.size() - _end < min_free) {
+		_buf.resize(_end + min_free);
+	}
+
+	return _buf.data() + _end;
+}
+
+size_t LineBuffer::writableSize(void) const {
+	return _buf.size() - _end;
+}
+
+void LineBuffer::commit(size_t count) {
+	_end += count;
+}
+
+void LineBuffer::clear(void) {
+	_begin = _scan = _end = 0;
+	_discarding = false;
+}
+
+} // IRCClient
+
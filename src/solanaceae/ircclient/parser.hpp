@@ -0,0 +1,98 @@
+#pragma once
+
+#include "./params.hpp"
+
+#include <string_view>
+#include <vector>
+#include <array>
+#include <cstddef>
+
+namespace IRCClient {
+
+	// first occurrence of c in [begin, end), or end
+	// sse2/avx2 if the target has them, scalar otherwise
+	const char* findByte(const char* begin, const char* end, char c);
+
+	// one irc line, split in place
+	// all views point into the line that was parsed
+	//
+	// [@tags] [:prefix] command [params...] [:trailing]
+	struct Message {
+		std::string_view tags; // without the '@', not split
+		std::string_view prefix; // without the ':'
+		std::string_view command;
+
+		std::array<std::string_view, max_params> params_array;
+		size_t params_count {0};
+
+		Params params(void) const {
+			return {params_array.data(), params_count};
+		}
+	};
+
+	// line without the line ending
+	// returns false if there is no command
+	bool parseMessage(std::string_view line, Message& msg);
+
+	// receive buffer, the socket reads directly into it
+	// and complete lines are handed out as views, without copying
+	class LineBuffer {
+		std::vector<char> _buf;
+		size_t _begin {0}; // start of the first incomplete line
+		size_t _scan {0}; // everything before this is known to not contain '\n'
+		size_t _end {0}; // end of received data
+
+		size_t _max_line;
+		bool _discarding {false}; // skipping the rest of an overlong line
+
+		public:
+			// rfc 1459 lines are 512, ircv3 allows tags on top
+			explicit LineBuffer(size_t max_line = 8191 + 512);
+
+			// makes room for at least min_free bytes and returns the start of it
+			char* writable(size_t min_free);
+			size_t writableSize(void) const;
+
+			// marks count bytes written to writable() as received
+			void commit(size_t count);
+
+			void clear(void);
+
+			// calls fn(std::string_view line) for every complete line, without the line ending
+			// the view is only valid during the call
+			// empty lines are skipped, overlong lines are dropped
+			template<typename Fn>
+			void consumeLines(Fn&& fn) {
+				const char* data = _buf.data();
+				for (;;) {
+					const char* nl = findByte(data + _scan, data + _end, '\n');
+					if (nl == data + _end) {
+						_scan = _end;
+						break;
+					}
+
+					const size_t line_end = static_cast<size_t>(nl - data);
+					size_t content_end = line_end;
+					if (content_end > _begin && data[content_end-1] == '\r') {
+						content_end--;
+					}
+
+					if (_discarding) {
+						_discarding = false;
+					} else if (content_end > _begin) {
+						fn(std::string_view{data + _begin, content_end - _begin});
+					}
+
+					_begin = _scan = line_end + 1;
+				}
+
+				if (_end - _begin > _max_line) {
+					// no line ending in sight, throw it away
+					_discarding = true;
+					_begin = _scan = _end;
+				}
+			}
+	};
+
+} // IRCClient
+
@@ -0,0 +1,185 @@
+#include "./poller.hpp"
+#include "./log.hpp"
+
+#if defined(__linux__)
+	#include <sys/epoll.h>
+	#include <sys/eventfd.h>
+	#include <sys/ioctl.h>
+	#include <unistd.h>
+	#include <cerrno>
+#elif defined(_WIN32)
+	#include <winsock2.h>
+#else
+	#include <sys/select.h>
+	#include <sys/ioctl.h>
+	#include <cerrno>
+#endif
+
+#include <algorithm>
+
+IRCClientPoller::IRCClientPoller(void) {
+#if defined(__linux__)
+	_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (_epoll_fd < 0) {
+		IRCC_LOG_ERROR("IRCCP error: epoll_create1 failed (" << errno << ")");
+		return;
+	}
+
+	_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (_wake_fd >= 0) {
+		epoll_event ev{};
+		ev.events = EPOLLIN | EPOLLET;
+		ev.data.ptr = &_wake_fd; // marks the wake event
+		if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wake_fd, &ev) != 0) {
+			close(_wake_fd);
+			_wake_fd = -1;
+		}
+	}
+#endif
+}
+
+IRCClientPoller::~IRCClientPoller(void) {
+#if defined(__linux__)
+	if (_wake_fd >= 0) {
+		close(_wake_fd);
+	}
+	if (_epoll_fd >= 0) {
+		close(_epoll_fd);
+	}
+#endif
+}
+
+bool IRCClientPoller::add(NativeSocket fd, void* user) {
+	if (fd == invalid_socket) {
+		return false;
+	}
+
+#if defined(__linux__)
+	epoll_event ev{};
+	// rdhup so a peer close shows up as readable, recv() then reports it
+	ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	ev.data.ptr = user;
+	if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+		IRCC_LOG_ERROR("IRCCP error: epoll_ctl add failed (" << errno << ")");
+		return false;
+	}
+#else
+	remove(fd);
+	_entries.push_back({fd, user});
+#endif
+
+	return true;
+}
+
+void IRCClientPoller::remove(NativeSocket fd) {
+	if (fd == invalid_socket) {
+		return;
+	}
+
+#if defined(__linux__)
+	// fails if the fd was already closed, which also removes it, so ignore errors
+	epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+#else
+	_entries.erase(
+		std::remove_if(_entries.begin(), _entries.end(), [fd](const Entry& e) { return e.fd == fd; }),
+		_entries.end()
+	);
+#endif
+}
+
+const std::vector<IRCClientPoller::Event>& IRCClientPoller::wait(int timeout_ms) {
+	_events.clear();
+
+#if defined(__linux__)
+	epoll_event evs[64];
+	const int count = epoll_wait(_epoll_fd, evs, 64, timeout_ms);
+	if (count < 0) {
+		if (errno != EINTR) {
+			IRCC_LOG_ERROR("IRCCP error: epoll_wait failed (" << errno << ")");
+		}
+		return _events;
+	}
+
+	for (int i = 0; i < count; i++) {
+		if (evs[i].data.ptr == &_wake_fd) {
+			// reset the counter, the wakeup itself is the whole point
+			uint64_t value {0};
+			[[maybe_unused]] const auto ret = read(_wake_fd, &value, sizeof(value));
+			continue;
+		}
+
+		_events.push_back({
+			evs[i].data.ptr,
+			(evs[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0,
+			(evs[i].events & (EPOLLOUT | EPOLLERR)) != 0,
+		});
+	}
+#else
+	if (_entries.empty()) {
+		return _events;
+	}
+
+	fd_set in_set, out_set;
+	FD_ZERO(&in_set);
+	FD_ZERO(&out_set);
+
+	NativeSocket maxfd = 0;
+	for (const auto& e : _entries) {
+		FD_SET(e.fd, &in_set);
+		FD_SET(e.fd, &out_set);
+		maxfd = std::max(maxfd, e.fd);
+	}
+
+	timeval tv;
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+	if (select(static_cast<int>(maxfd + 1), &in_set, &out_set, nullptr, timeout_ms < 0 ? nullptr : &tv) <= 0) {
+		return _events;
+	}
+
+	for (const auto& e : _entries) {
+		const bool readable = FD_ISSET(e.fd, &in_set);
+		const bool writable = FD_ISSET(e.fd, &out_set);
+		if (readable || writable) {
+			_events.push_back({e.user, readable, writable});
+		}
+	}
+#endif
+
+	return _events;
+}
+
+void IRCClientPoller::wake(void) {
+#if defined(__linux__)
+	if (_wake_fd >= 0) {
+		const uint64_t value {1};
+		[[maybe_unused]] const auto ret = write(_wake_fd, &value, sizeof(value));
+	}
+#endif
+}
+
+bool IRCClientPoller::canWake(void) const {
+#if defined(__linux__)
+	return _wake_fd >= 0;
+#else
+	return false;
+#endif
+}
+
+size_t IRCClientPoller::pendingBytes(NativeSocket fd) {
+#if defined(_WIN32)
+	u_long count = 0;
+	if (ioctlsocket(fd, FIONREAD, &count) != 0) {
+		return 0;
+	}
+	return count;
+#else
+	int count = 0;
+	if (ioctl(fd, FIONREAD, &count) != 0 || count < 0) {
+		return 0;
+	}
+	return static_cast<size_t>(count);
+#endif
+}
+
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// socket readiness notification for one or more sessions
+// linux: edge triggered epoll, the fd set is kept in the kernel
+// other: select() fallback, rebuilds the fd_set on every wait
+//
+// since readiness is edge triggered, the user has to latch it
+// and keep draining the socket until pendingBytes() returns 0
+class IRCClientPoller {
+	public:
+#if defined(_WIN32)
+		using NativeSocket = uintptr_t; // SOCKET
+		static constexpr NativeSocket invalid_socket {~NativeSocket(0)};
+#else
+		using NativeSocket = int;
+		static constexpr NativeSocket invalid_socket {-1};
+#endif
+
+		struct Event {
+			void* user {nullptr};
+			bool readable {false};
+			bool writable {false};
+		};
+
+	private:
+#if defined(__linux__)
+		int _epoll_fd {-1};
+		int _wake_fd {-1}; // eventfd, interrupts a blocking wait
+#else
+		struct Entry {
+			NativeSocket fd;
+			void* user;
+		};
+		std::vector<Entry> _entries;
+#endif
+
+		std::vector<Event> _events; // reused between waits
+
+	public:
+		IRCClientPoller(void);
+		~IRCClientPoller(void);
+
+		IRCClientPoller(const IRCClientPoller&) = delete;
+		IRCClientPoller& operator=(const IRCClientPoller&) = delete;
+
+		bool add(NativeSocket fd, void* user);
+		void remove(NativeSocket fd);
+
+		// timeout_ms: 0 is non blocking, <0 blocks indefinitely
+		// the returned events are valid until the next call
+		const std::vector<Event>& wait(int timeout_ms);
+
+		// thread safe, makes a concurrent (or the next) wait return early
+		// not supported by the select fallback, check canWake()
+		void wake(void);
+		bool canWake(void) const;
+
+		// bytes readable from the kernel socket buffer without blocking
+		static size_t pendingBytes(NativeSocket fd);
+};
+
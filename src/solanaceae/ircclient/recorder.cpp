@@ -0,0 +1,164 @@
+#include "./recorder.hpp"
+
+#include "./log.hpp"
+
+#include <charconv>
+#include <algorithm>
+
+namespace IRCClient {
+
+Recorder::~Recorder(void) {
+	if (_file != nullptr) {
+		std::fclose(_file);
+	}
+}
+
+bool Recorder::open(const std::string& path, std::string_view server, std::string_view nick) {
+	if (_file != nullptr) {
+		std::fclose(_file);
+		_file = nullptr;
+	}
+
+	_file = std::fopen(path.c_str(), "wb");
+	if (_file == nullptr) {
+		IRCC_LOG_ERROR("IRCC error: failed to open recording '" << path << "'");
+		return false;
+	}
+
+	_file_buffer.resize(1024*1024);
+	std::setvbuf(_file, _file_buffer.data(), _IOFBF, _file_buffer.size());
+
+	comment("solanaceae_ircclient recording 1");
+	comment("server " + std::string{server});
+	comment("nick " + std::string{nick});
+
+	_last = std::chrono::steady_clock::now();
+
+	return true;
+}
+
+bool Recorder::isOpen(void) const {
+	return _file != nullptr;
+}
+
+void Recorder::record(Direction dir, std::string_view line) {
+	if (_file == nullptr) {
+		return;
+	}
+
+	const auto now = std::chrono::steady_clock::now();
+	const auto delta = std::chrono::duration_cast<std::chrono::microseconds>(now - _last).count();
+	_last = now;
+
+	char prefix[32];
+	auto res = std::to_chars(prefix, prefix + sizeof(prefix) - 3, static_cast<uint64_t>(delta));
+	*res.ptr++ = ' ';
+	*res.ptr++ = dir == Direction::in ? 'i' : 'o';
+	*res.ptr++ = ' ';
+
+	std::fwrite(prefix, 1, static_cast<size_t>(res.ptr - prefix), _file);
+	std::fwrite(line.data(), 1, line.size(), _file);
+	std::fputc('\n', _file);
+}
+
+void Recorder::comment(std::string_view text) {
+	if (_file == nullptr) {
+		return;
+	}
+
+	std::fwrite("# ", 1, 2, _file);
+	std::fwrite(text.data(), 1, text.size(), _file);
+	std::fputc('\n', _file);
+}
+
+void Recorder::flush(void) {
+	if (_file != nullptr) {
+		std::fflush(_file);
+	}
+}
+
+bool RecordingReader::open(const std::string& path) {
+	_file.open(path, std::ios::binary);
+	if (!_file.is_open()) {
+		return false;
+	}
+
+	// headers come first
+	while (std::getline(_file, _line)) {
+		if (_line.empty()) {
+			continue;
+		}
+
+		if (_line.front() != '#') {
+			_pending = true;
+			break;
+		}
+
+		const std::string_view header = std::string_view{_line}.substr(std::min<size_t>(2, _line.size()));
+		if (header.substr(0, 7) == "server ") {
+			_server = header.substr(7);
+		} else if (header.substr(0, 5) == "nick ") {
+			_nick = header.substr(5);
+		}
+	}
+
+	return true;
+}
+
+const std::string& RecordingReader::getServer(void) const {
+	return _server;
+}
+
+const std::string& RecordingReader::getNick(void) const {
+	return _nick;
+}
+
+bool RecordingReader::next(Record& rec) {
+	if (_pending) {
+		_pending = false;
+		if (parseRecord(rec)) {
+			return true;
+		}
+	}
+
+	while (std::getline(_file, _line)) {
+		if (_line.empty() || _line.front() == '#') {
+			continue;
+		}
+
+		if (parseRecord(rec)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool RecordingReader::parseRecord(Record& rec) {
+	if (!_line.empty() && _line.back() == '\r') {
+		_line.pop_back();
+	}
+
+	uint64_t delta {0};
+	const auto res = std::from_chars(_line.data(), _line.data() + _line.size(), delta);
+	if (res.ec != std::errc{}) {
+		return false;
+	}
+
+	const size_t pos = static_cast<size_t>(res.ptr - _line.data());
+	// " i " or " o "
+	if (pos + 3 > _line.size() || _line[pos] != ' ' || _line[pos+2] != ' ') {
+		return false;
+	}
+
+	_time += std::chrono::microseconds{delta};
+
+	rec.time = _time;
+	rec.dir = _line[pos+1] == 'o' ? Direction::out : Direction::in;
+	rec.line = std::string_view{_line}.substr(pos + 3);
+
+	return true;
+}
+
+} // IRCClient
+
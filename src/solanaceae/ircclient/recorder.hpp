@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+
+// raw wire traffic recordings, for replaying without a network (see irc_replay)
+//
+// text, one line per record:
+// <us since the previous record> <i|o> <line without crlf>
+// lines starting with '#' are headers/comments:
+// # server <server>
+// # nick <nick>
+namespace IRCClient {
+
+	enum class Direction : uint8_t {
+		in,
+		out,
+	};
+
+	class Recorder {
+		std::FILE* _file {nullptr};
+		std::vector<char> _file_buffer; // big stdio buffer, the io thread should not block on disk
+		std::chrono::steady_clock::time_point _last {};
+
+		public:
+			Recorder(void) = default;
+			~Recorder(void);
+
+			Recorder(const Recorder&) = delete;
+			Recorder& operator=(const Recorder&) = delete;
+
+			// truncates path
+			bool open(const std::string& path, std::string_view server, std::string_view nick);
+			bool isOpen(void) const;
+
+			void record(Direction dir, std::string_view line);
+			void comment(std::string_view text);
+			void flush(void);
+	};
+
+	class RecordingReader {
+		std::ifstream _file;
+		std::string _line; // backing for the current record
+		std::string _server;
+		std::string _nick;
+
+		public:
+			struct Record {
+				std::chrono::microseconds time {0}; // since the first record
+				Direction dir {Direction::in};
+				std::string_view line; // valid until the next call to next()
+			};
+
+			// also reads the headers
+			bool open(const std::string& path);
+
+			const std::string& getServer(void) const;
+			const std::string& getNick(void) const;
+
+			// false at the end of the recording
+			bool next(Record& rec);
+
+		private:
+			std::chrono::microseconds _time {0};
+			bool _pending {false}; // _line holds a record read while parsing the headers
+
+			bool parseRecord(Record& rec);
+	};
+
+} // IRCClient
+
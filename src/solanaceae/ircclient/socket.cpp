@@ -0,0 +1,169 @@
+#include "./socket.hpp"
+
+#include "./log.hpp"
+
+#if defined(_WIN32)
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+#else
+	#include <sys/types.h>
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+	#include <netinet/tcp.h>
+	#include <netdb.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <cerrno>
+#endif
+
+namespace IRCClient::Socket {
+
+namespace {
+
+bool setNonBlocking(NativeSocket sock) {
+#if defined(_WIN32)
+	u_long mode = 1;
+	return ioctlsocket(sock, FIONBIO, &mode) == 0;
+#else
+	const int flags = fcntl(sock, F_GETFL, 0);
+	return flags >= 0 && fcntl(sock, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+bool wouldBlock(void) {
+#if defined(_WIN32)
+	const int err = WSAGetLastError();
+	return err == WSAEWOULDBLOCK || err == WSAEINPROGRESS;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS;
+#endif
+}
+
+// a signal hit the syscall, nothing happened yet
+bool interrupted(void) {
+#if defined(_WIN32)
+	return false;
+#else
+	return errno == EINTR;
+#endif
+}
+
+} // anonymous
+
+NativeSocket connectTCP(const std::string& host, uint16_t port) {
+	addrinfo hints{};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	addrinfo* result {nullptr};
+	const std::string port_str = std::to_string(port);
+	if (const int err = getaddrinfo(host.c_str(), port_str.c_str(), &hints, &result); err != 0) {
+		IRCC_LOG_ERROR("IRCC error: failed to resolve '" << host << "' (" << err << ")");
+		return IRCClientPoller::invalid_socket;
+	}
+
+	NativeSocket sock {IRCClientPoller::invalid_socket};
+	for (addrinfo* ai = result; ai != nullptr; ai = ai->ai_next) {
+		sock = static_cast<NativeSocket>(::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol));
+		if (sock == IRCClientPoller::invalid_socket) {
+			continue;
+		}
+
+		if (!setNonBlocking(sock)) {
+			close(sock);
+			sock = IRCClientPoller::invalid_socket;
+			continue;
+		}
+
+		// irc is many small lines, dont let nagle hold them back
+		const int one = 1;
+		setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+
+		// an interrupted connect carries on in the background, like a non blocking one
+		if (::connect(sock, ai->ai_addr, static_cast<int>(ai->ai_addrlen)) == 0 || wouldBlock() || interrupted()) {
+			break;
+		}
+
+		close(sock);
+		sock = IRCClientPoller::invalid_socket;
+	}
+
+	freeaddrinfo(result);
+
+	if (sock == IRCClientPoller::invalid_socket) {
+		IRCC_LOG_ERROR("IRCC error: failed to connect to '" << host << "'");
+	}
+
+	return sock;
+}
+
+bool finishConnect(NativeSocket sock) {
+	int err {0};
+#if defined(_WIN32)
+	int len = sizeof(err);
+#else
+	socklen_t len = sizeof(err);
+#endif
+	if (getsockopt(sock, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&err), &len) != 0) {
+		return false;
+	}
+	return err == 0;
+}
+
+IOResult recvSome(NativeSocket sock, char* data, size_t size, size_t& received) {
+	received = 0;
+	// retried on EINTR, the caller drains until would_block (edge triggered),
+	// giving up early would spend the edge and stall the connection
+#if defined(_WIN32)
+	const int ret = ::recv(sock, data, static_cast<int>(size), 0);
+#else
+	ssize_t ret {-1};
+	do {
+		ret = ::recv(sock, data, size, 0);
+	} while (ret < 0 && interrupted());
+#endif
+	if (ret > 0) {
+		received = static_cast<size_t>(ret);
+		return IOResult::ok;
+	}
+	if (ret == 0) {
+		return IOResult::closed;
+	}
+	return wouldBlock() ? IOResult::would_block : IOResult::error;
+}
+
+IOResult sendSome(NativeSocket sock, const char* data, size_t size, size_t& sent) {
+	sent = 0;
+#if defined(_WIN32)
+	const int ret = ::send(sock, data, static_cast<int>(size), 0);
+#else
+	#if defined(MSG_NOSIGNAL)
+	constexpr int flags {MSG_NOSIGNAL};
+	#else
+	constexpr int flags {0};
+	#endif
+	ssize_t ret {-1};
+	do {
+		ret = ::send(sock, data, size, flags);
+	} while (ret < 0 && interrupted());
+#endif
+	if (ret >= 0) {
+		sent = static_cast<size_t>(ret);
+		return IOResult::ok;
+	}
+	return wouldBlock() ? IOResult::would_block : IOResult::error;
+}
+
+void close(NativeSocket sock) {
+	if (sock == IRCClientPoller::invalid_socket) {
+		return;
+	}
+#if defined(_WIN32)
+	::closesocket(sock);
+#else
+	::close(sock);
+#endif
+}
+
+} // IRCClient::Socket
+
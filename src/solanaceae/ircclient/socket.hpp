@@ -0,0 +1,34 @@
+#pragma once
+
+#include "./poller.hpp"
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// minimal non blocking tcp, for the native transport
+namespace IRCClient::Socket {
+
+	using NativeSocket = IRCClientPoller::NativeSocket;
+
+	enum class IOResult : uint8_t {
+		ok,
+		would_block,
+		closed, // orderly shutdown by the peer
+		error,
+	};
+
+	// resolves (blocking, same as libircclient) and starts a non blocking connect
+	// the socket reports writable once the connect finished, check it with finishConnect()
+	NativeSocket connectTCP(const std::string& host, uint16_t port);
+
+	// false if the connect failed
+	bool finishConnect(NativeSocket sock);
+
+	IOResult recvSome(NativeSocket sock, char* data, size_t size, size_t& received);
+	IOResult sendSome(NativeSocket sock, const char* data, size_t size, size_t& sent);
+
+	void close(NativeSocket sock);
+
+} // IRCClient::Socket
+
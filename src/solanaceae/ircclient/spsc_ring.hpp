@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+namespace IRCClient {
+
+// bounded lock-free single producer single consumer ring
+// slots are constructed once and reused, so elements holding buffers
+// (strings, vectors) keep their capacity and steady state is allocation free
+//
+// producer: if (auto* slot = ring.acquire()) { fill(*slot); ring.commit(); }
+// consumer: while (auto* slot = ring.front()) { use(*slot); ring.pop(); }
+template<typename T>
+class SPSCRing {
+	std::vector<T> _slots;
+	size_t _mask {0};
+
+	// separate cache lines, so producer and consumer dont false share
+	alignas(64) std::atomic<size_t> _head {0}; // next slot to read, written by the consumer
+	alignas(64) std::atomic<size_t> _tail {0}; // next slot to write, written by the producer
+
+	static size_t roundUpPow2(size_t value) {
+		size_t ret = 1;
+		while (ret < value) {
+			ret <<= 1;
+		}
+		return ret;
+	}
+
+	public:
+		explicit SPSCRing(size_t capacity) : _slots(roundUpPow2(capacity < 2 ? 2 : capacity)) {
+			_mask = _slots.size() - 1;
+		}
+
+		SPSCRing(const SPSCRing&) = delete;
+		SPSCRing& operator=(const SPSCRing&) = delete;
+
+		size_t capacity(void) const {
+			return _slots.size();
+		}
+
+		// approximate if called concurrently
+		size_t size(void) const {
+			return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+		}
+
+	public: // producer
+		// returns nullptr if full
+		T* acquire(void) {
+			const size_t tail = _tail.load(std::memory_order_relaxed);
+			if (tail - _head.load(std::memory_order_acquire) == _slots.size()) {
+				return nullptr;
+			}
+			return &_slots[tail & _mask];
+		}
+
+		// publishes the slot returned by acquire()
+		void commit(void) {
+			_tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+
+	public: // consumer
+		// returns nullptr if empty
+		T* front(void) {
+			const size_t head = _head.load(std::memory_order_relaxed);
+			if (head == _tail.load(std::memory_order_acquire)) {
+				return nullptr;
+			}
+			return &_slots[head & _mask];
+		}
+
+		// hands the slot returned by front() back to the producer
+		void pop(void) {
+			_head.store(_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+};
+
+} // IRCClient
+
@@ -0,0 +1,107 @@
+#include "./tags.hpp"
+
+namespace IRCClient {
+
+std::string Tags::unescape(std::string_view value) {
+	std::string ret;
+	ret.reserve(value.size());
+
+	for (size_t i = 0; i < value.size(); i++) {
+		if (value[i] != '\\') {
+			ret += value[i];
+			continue;
+		}
+
+		if (++i == value.size()) {
+			break; // trailing backslash is dropped
+		}
+
+		switch (value[i]) {
+			case ':': ret += ';'; break;
+			case 's': ret += ' '; break;
+			case 'r': ret += '\r'; break;
+			case 'n': ret += '\n'; break;
+			default: ret += value[i]; break; // includes '\\'
+		}
+	}
+
+	return ret;
+}
+
+namespace {
+
+// fixed width decimal, no sign
+bool parseDigits(std::string_view str, size_t pos, size_t count, int64_t& out) {
+	if (pos + count > str.size()) {
+		return false;
+	}
+
+	out = 0;
+	for (size_t i = pos; i < pos + count; i++) {
+		if (str[i] < '0' || str[i] > '9') {
+			return false;
+		}
+		out = out * 10 + (str[i] - '0');
+	}
+
+	return true;
+}
+
+// days since 1970-01-01 for a proleptic gregorian date
+// http://howardhinnant.github.io/date_algorithms.html#days_from_civil
+int64_t daysFromCivil(int64_t y, int64_t m, int64_t d) {
+	y -= m <= 2;
+	const int64_t era = (y >= 0 ? y : y-399) / 400;
+	const int64_t yoe = y - era * 400;
+	const int64_t doy = (153*(m > 2 ? m-3 : m+9) + 2)/5 + d-1;
+	const int64_t doe = yoe * 365 + yoe/4 - yoe/100 + doy;
+	return era * 146097 + doe - 719468;
+}
+
+} // anonymous
+
+std::optional<uint64_t> parseServerTime(std::string_view value) {
+	// 2011-10-19T16:40:51.620Z
+	int64_t year, month, day, hour, minute, second;
+	if (
+		!parseDigits(value, 0, 4, year) || value.size() < 20 || value[4] != '-' ||
+		!parseDigits(value, 5, 2, month) || value[7] != '-' ||
+		!parseDigits(value, 8, 2, day) || value[10] != 'T' ||
+		!parseDigits(value, 11, 2, hour) || value[13] != ':' ||
+		!parseDigits(value, 14, 2, minute) || value[16] != ':' ||
+		!parseDigits(value, 17, 2, second)
+	) {
+		return std::nullopt;
+	}
+
+	if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+		return std::nullopt;
+	}
+
+	// optional fraction, any precision, we keep ms
+	int64_t ms {0};
+	size_t pos = 19;
+	if (pos < value.size() && value[pos] == '.') {
+		pos++;
+		int64_t scale = 100;
+		while (pos < value.size() && value[pos] >= '0' && value[pos] <= '9') {
+			ms += (value[pos] - '0') * scale;
+			scale /= 10;
+			pos++;
+		}
+	}
+
+	if (pos >= value.size() || value[pos] != 'Z') {
+		return std::nullopt;
+	}
+
+	const int64_t days = daysFromCivil(year, month, day);
+	if (days < 0) {
+		return std::nullopt;
+	}
+
+	return static_cast<uint64_t>(((days * 24 + hour) * 60 + minute) * 60 + second) * 1000 + static_cast<uint64_t>(ms);
+}
+
+} // IRCClient
+
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <optional>
+#include <cstdint>
+
+namespace IRCClient {
+
+	// non owning view over the ircv3 message tags of an event
+	// @key=value;key2;+client/key=value
+	// only the native transport fills these, same lifetime rules as Params
+	class Tags {
+		std::string_view _raw; // without the '@'
+
+		public:
+			constexpr Tags(void) = default;
+			constexpr explicit Tags(std::string_view raw) : _raw(raw) {}
+
+			constexpr bool empty(void) const { return _raw.empty(); }
+			constexpr std::string_view raw(void) const { return _raw; }
+
+			// the still escaped value, empty if the tag has no value
+			// nullopt if not present
+			std::optional<std::string_view> get(std::string_view key) const {
+				std::string_view rest = _raw;
+				while (!rest.empty()) {
+					const auto end = rest.find(';');
+					const std::string_view tag = rest.substr(0, end);
+					rest = end == std::string_view::npos ? std::string_view{} : rest.substr(end+1);
+
+					const auto eq = tag.find('=');
+					if (tag.substr(0, eq) == key) {
+						return eq == std::string_view::npos ? std::string_view{} : tag.substr(eq+1);
+					}
+				}
+				return std::nullopt;
+			}
+
+			bool has(std::string_view key) const {
+				return get(key).has_value();
+			}
+
+			// undoes the tag value escaping (\: \s \\ \r \n)
+			static std::string unescape(std::string_view value);
+	};
+
+	// server-time value (YYYY-MM-DDThh:mm:ss.sssZ) to ms since unix epoch
+	std::optional<uint64_t> parseServerTime(std::string_view value);
+
+} // IRCClient
+
@@ -1,13 +1,23 @@
 #pragma once
 
+#include <solanaceae/contact/contact_model4.hpp>
+
+#include <unordered_map>
+#include <vector>
 #include <string>
+#include <cstdint>
 
 namespace Contact::Components::IRC {
 
+	// only on the server contact, channels and users point to it with Parent
 	struct ServerName {
 		std::string name;
 	};
 
+	// channel and user names are not interned, each contact owns its copy
+	// nicks and channels almost always fit the small string buffer, so a pooled handle would not be smaller,
+	// and the pool would have to outlive every contact that points into it
+	// large rosters are kept small with "lazy_members" instead
 	struct ChannelName {
 		std::string name;
 	};
@@ -16,8 +26,45 @@ namespace Contact::Components::IRC {
 		std::string name;
 	};
 
+	// on channels, next to ParentOf
+	// user -> position in ParentOf::subs, for O(1) membership tests
+	// and swap-pop removal (so the subs order is not stable)
+	struct ChannelMembers {
+		struct Member {
+			size_t pos {0};
+			uint8_t privileges {0}; // IRCClient::ChannelModes::Privilege bits (eg. op, voice)
+		};
+		std::unordered_map<Contact4, Member> index;
+	};
+
+	// on users, the channels we know them to be in (the reverse of ChannelMembers)
+	// few per user, so a plain vector
+	struct UserChannels {
+		std::vector<Contact4> channels;
+	};
+
+	// on channels, all members we know of, including the ones without a contact (config "lazy_members")
+	// so the total does not need ParentOf
+	struct MemberCount {
+		size_t count {0};
+	};
+
+	// on channels, timestamp (ms) of the last message, for the rejoin order
+	struct ChannelActivity {
+		uint64_t last_ts {0};
+	};
+
+	// on users we exchanged private messages with, timestamp (ms) of the last one
+	// these are never evicted as idle (config "max_idle_users")
+	struct PrivateActivity {
+		uint64_t last_ts {0};
+	};
+
+	// on users that wrote a message we stored, their messages point at them (ContactFrom)
+	// these are never evicted as idle (config "max_idle_users")
+	struct TagMessageAuthor {};
+
 	// TODO:
-	// - membership level in channels
 	// - dcc stuff
 	// - tags for server channel user?
 
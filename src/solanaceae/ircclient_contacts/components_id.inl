@@ -17,6 +17,12 @@ constexpr entt::id_type entt::type_hash<x>::value() noexcept { \
 DEFINE_COMP_ID(Contact::Components::IRC::ServerName)
 DEFINE_COMP_ID(Contact::Components::IRC::ChannelName)
 DEFINE_COMP_ID(Contact::Components::IRC::UserName)
+DEFINE_COMP_ID(Contact::Components::IRC::ChannelMembers)
+DEFINE_COMP_ID(Contact::Components::IRC::UserChannels)
+DEFINE_COMP_ID(Contact::Components::IRC::MemberCount)
+DEFINE_COMP_ID(Contact::Components::IRC::ChannelActivity)
+DEFINE_COMP_ID(Contact::Components::IRC::PrivateActivity)
+DEFINE_COMP_ID(Contact::Components::IRC::TagMessageAuthor)
 
 #undef DEFINE_COMP_ID
 
@@ -44,7 +44,7 @@ void registerIRCComponents2Str(ContactStore4I& cs) {
 
 void unregisterIRCComponents2Str(ContactStore4I& cs) {
 	cs.unregisterComponentToString(
-		entt::type_id<Contact::Components::IRC::UserName>().hash()
+		entt::type_id<Contact::Components::IRC::ServerName>().hash()
 	);
 	cs.unregisterComponentToString(
 		entt::type_id<Contact::Components::IRC::ChannelName>().hash()
@@ -5,6 +5,7 @@
 #include <solanaceae/contact/contact_store_i.hpp>
 #include <solanaceae/contact/components.hpp>
 #include <solanaceae/util/utils.hpp>
+#include <solanaceae/ircclient/log.hpp>
 
 #include <libirc_rfcnumeric.h>
 #include <libircclient.h>
@@ -17,7 +18,22 @@
 #include <cstdint>
 #include <string_view>
 #include <vector>
-#include <iostream>
+#include <algorithm>
+
+namespace {
+
+// subs was changed behind our back (or loaded), keeps the privileges we know
+void reindexMembers(const std::vector<Contact4>& subs, Contact::Components::IRC::ChannelMembers& members) {
+	decltype(members.index) new_index;
+	new_index.reserve(subs.size());
+	for (size_t i = 0; i < subs.size(); i++) {
+		const auto it = members.index.find(subs[i]);
+		new_index.try_emplace(subs[i], Contact::Components::IRC::ChannelMembers::Member{i, it != members.index.end() ? it->second.privileges : uint8_t{0}});
+	}
+	members.index = std::move(new_index);
+}
+
+} // anonymous
 
 IRCClientContactModel::IRCClientContactModel(
 	ContactStore4I& cs,
@@ -31,38 +47,50 @@ IRCClientContactModel::IRCClientContactModel(
 
 		.subscribe(IRCClient_Event::JOIN)
 		.subscribe(IRCClient_Event::PART)
+		.subscribe(IRCClient_Event::MODE)
+		.subscribe(IRCClient_Event::KICK)
 		.subscribe(IRCClient_Event::TOPIC)
 		.subscribe(IRCClient_Event::QUIT)
+		.subscribe(IRCClient_Event::NICK)
 
 		.subscribe(IRCClient_Event::CTCP_REQ)
 
+		.subscribe(IRCClient_Event::BATCH)
+
 		.subscribe(IRCClient_Event::DISCONNECT)
+
+		.subscribe(IRCClient_Event::DISPATCH_DONE)
 	;
 
+	_deferred_updates = _conf.get_bool(_ircc.getConfigSection(), "deferred_contact_updates").value_or(false);
+	_lazy_members = _conf.get_bool(_ircc.getConfigSection(), "lazy_members").value_or(false);
+	_max_idle_users = static_cast<size_t>(std::max<int64_t>(0, _conf.get_int(_ircc.getConfigSection(), "max_idle_users").value_or(0)));
+
+	_cs.registry().on_destroy<Contact::Components::IRC::ChannelName>().connect<&IRCClientContactModel::onChannelNameDestroy>(*this);
+	_cs.registry().on_destroy<Contact::Components::IRC::UserName>().connect<&IRCClientContactModel::onUserNameDestroy>(*this);
+
 	// dont create server self etc until connect event comes
 
-	for (const auto& [channel, should_join] : _conf.entries_bool("IRCClient", "autojoin")) {
+	for (const auto& [channel, should_join] : _conf.entries_bool(_ircc.getConfigSection(), "autojoin")) {
 		if (should_join) {
-			std::cout << "IRCCCM: autojoining " << channel << "\n";
+			IRCC_LOG_INFO("IRCCCM: autojoining " << channel);
 			join(channel);
 		}
 	}
 }
 
 IRCClientContactModel::~IRCClientContactModel(void) {
+	_cs.registry().on_destroy<Contact::Components::IRC::ChannelName>().disconnect(this);
+	_cs.registry().on_destroy<Contact::Components::IRC::UserName>().disconnect(this);
 }
 
 void IRCClientContactModel::join(const std::string& channel) {
 	if (_connected) {
-		irc_cmd_join(
-			_ircc.getSession(),
-			channel.c_str(),
-			""
-		);
-		std::cout << "IRCCCM: connected joining channel...\n";
+		_ircc.join(channel);
+		IRCC_LOG_DEBUG("IRCCCM: connected joining channel...");
 	} else {
 		_join_queue.push(channel);
-		std::cout << "IRCCCM: not connected yet, queued join...\n";
+		IRCC_LOG_DEBUG("IRCCCM: not connected yet, queued join...");
 	}
 }
 
@@ -100,47 +128,70 @@ std::vector<uint8_t> IRCClientContactModel::getHash(std::string_view value) {
 	return hash;
 }
 
-std::vector<uint8_t> IRCClientContactModel::getHash(const std::vector<uint8_t>& value) {
-	assert(!value.empty());
-
-	std::vector<uint8_t> hash(crypto_hash_sha256_bytes(), 0x00);
-	crypto_hash_sha256(hash.data(), value.data(), value.size());
-	return hash;
-}
-
-std::vector<uint8_t> IRCClientContactModel::getIDHash(std::string_view name) {
+IRCClientContactModel::IDHash IRCClientContactModel::getIDHash(std::string_view name) {
 	assert(!_server_hash.empty());
 	assert(!name.empty());
 
-	std::vector<uint8_t> data = _server_hash;
-	data.insert(data.end(), name.begin(), name.end());
-	return getHash(data);
+	if (const auto it = _id_memo.find(name); it != _id_memo.end()) {
+		return it->second;
+	}
+
+	// continue from the state primed with the server hash
+	auto state = _id_hash_state;
+	crypto_hash_sha256_update(&state, reinterpret_cast<const uint8_t*>(name.data()), name.size());
+	IDHash hash;
+	crypto_hash_sha256_final(&state, hash.data());
+
+	if (_id_memo.size() >= _id_memo_max) {
+		_id_memo.clear();
+	}
+	_id_memo.emplace(name, hash);
+
+	return hash;
 }
 
 ContactHandle4 IRCClientContactModel::getC(std::string_view channel) {
-	const auto server_name = _ircc.getServerName();
+	const auto it = _channel_index.find(nameKey(channel));
+	if (it == _channel_index.end()) {
+		return {};
+	}
+
 	const auto& cr = _cs.registry();
-	// TODO: this needs a better way
-	for (const auto e : cr.view<Contact::Components::IRC::ServerName, Contact::Components::IRC::ChannelName>()) {
-		if (cr.get<Contact::Components::IRC::ServerName>(e).name == server_name && cr.get<Contact::Components::IRC::ChannelName>(e).name == channel) {
-			return _cs.contactHandle(e);
-		}
+	const auto* cn = cr.valid(it->second) ? cr.try_get<Contact::Components::IRC::ChannelName>(it->second) : nullptr;
+	if (cn == nullptr || !_ircc.getISupport().equalFold(cn->name, channel)) {
+		// stale
+		_channel_index.erase(it);
+		return {};
 	}
 
-	return {};
+	return _cs.contactHandle(it->second);
 }
 
 ContactHandle4 IRCClientContactModel::getU(std::string_view nick) {
-	const auto server_name = _ircc.getServerName();
-	const auto& cr = _cs.registry();
-	// TODO: this needs a better way
-	for (const auto e : cr.view<Contact::Components::IRC::ServerName, Contact::Components::IRC::UserName>()) {
-		if (cr.get<Contact::Components::IRC::ServerName>(e).name == server_name && cr.get<Contact::Components::IRC::UserName>(e).name == nick) {
-			return _cs.contactHandle(e);
+	auto user = findU(nick);
+	if (!static_cast<bool>(user) && _lazy_members) {
+		if (auto* lazy = findLazyU(nick); lazy != nullptr) {
+			user = materializeU(*lazy);
 		}
 	}
+	return user;
+}
+
+ContactHandle4 IRCClientContactModel::findU(std::string_view nick) {
+	const auto it = _user_index.find(nameKey(nick));
+	if (it == _user_index.end()) {
+		return {};
+	}
+
+	const auto& cr = _cs.registry();
+	const auto* un = cr.valid(it->second) ? cr.try_get<Contact::Components::IRC::UserName>(it->second) : nullptr;
+	if (un == nullptr || !_ircc.getISupport().equalFold(un->name, nick)) {
+		// stale
+		_user_index.erase(it);
+		return {};
+	}
 
-	return {};
+	return _cs.contactHandle(it->second);
 }
 
 ContactHandle4 IRCClientContactModel::getCU(std::string_view name) {
@@ -148,29 +199,691 @@ ContactHandle4 IRCClientContactModel::getCU(std::string_view name) {
 		return {};
 	}
 
-	static constexpr std::string_view channel_prefixes{
-		// rfc 1459 1.3
-		"&" // local
-		"#" // regular
-
-		// rfc 2812 1.3
-		"+"
-		"!"
-	};
-
-	if (channel_prefixes.find(name.front()) != std::string_view::npos) {
+	// CHANTYPES, rfc 1459 and 2812 "&#+!" if not advertised
+	if (_ircc.getISupport().isChannelName(name)) {
 		return getC(name);
 	} else {
 		return getU(name);
 	}
 }
 
+const IRCClientContactModel::UpdateStats& IRCClientContactModel::getUpdateStats(void) const {
+	return _update_stats;
+}
+
+const std::string& IRCClientContactModel::nameKey(std::string_view name) {
+	_ircc.getISupport().foldInto(name, _name_key);
+	return _name_key;
+}
+
+void IRCClientContactModel::rebuildNameIndex(void) {
+	_channel_index.clear();
+	_user_index.clear();
+
+	const auto& cr = _cs.registry();
+
+	// contacts from a previous session or loaded from disk
+	cr.view<Contact::Components::Parent, Contact::Components::IRC::ChannelName>().each([this](const auto c, const auto& p_c, const auto& cn_c) {
+		if (p_c.parent == _server) {
+			_channel_index[nameKey(cn_c.name)] = c;
+		}
+	});
+
+	cr.view<Contact::Components::Parent, Contact::Components::IRC::UserName>().each([this](const auto c, const auto& p_c, const auto& un_c) {
+		if (p_c.parent == _server) {
+			_user_index[nameKey(un_c.name)] = c;
+			// self is skipped on eviction
+			updateIdle(c);
+		}
+	});
+}
+
+void IRCClientContactModel::indexChannel(Contact4 c, std::string_view name) {
+	const auto& key = nameKey(name);
+	if (auto it = _channel_index.find(key); it != _channel_index.end()) {
+		it->second = c;
+	} else {
+		_channel_index.emplace(key, c);
+	}
+}
+
+void IRCClientContactModel::indexUser(Contact4 c, std::string_view name) {
+	const auto& key = nameKey(name);
+	if (auto it = _user_index.find(key); it != _user_index.end()) {
+		it->second = c;
+	} else {
+		_user_index.emplace(key, c);
+	}
+}
+
+void IRCClientContactModel::onChannelNameDestroy(ContactRegistry4& cr, const Contact4 c) {
+	// fired before the component is removed
+	const auto it = _channel_index.find(nameKey(cr.get<Contact::Components::IRC::ChannelName>(c).name));
+	if (it != _channel_index.end() && it->second == c) {
+		_channel_index.erase(it);
+	}
+}
+
+void IRCClientContactModel::onUserNameDestroy(ContactRegistry4& cr, const Contact4 c) {
+	const auto it = _user_index.find(nameKey(cr.get<Contact::Components::IRC::UserName>(c).name));
+	if (it != _user_index.end() && it->second == c) {
+		_user_index.erase(it);
+	}
+}
+
+ContactHandle4 IRCClientContactModel::makeU(std::string_view nick, bool& created) {
+	created = false;
+
+	const auto user_hash = getIDHash(nick);
+	// check for empty contact by id
+	auto user = _cs.getOneContactByID(_server, ByteSpan{user_hash.data(), user_hash.size()});
+	if (!static_cast<bool>(user)) {
+		user = _cs.contactHandle(_cs.registry().create());
+		created = true;
+		user.emplace_or_replace<Contact::Components::ID>(std::vector<uint8_t>{user_hash.cbegin(), user_hash.cend()});
+	}
+
+	user.emplace_or_replace<Contact::Components::ContactModel>(this);
+	user.emplace_or_replace<Contact::Components::Parent>(_server);
+	user.emplace_or_replace<Contact::Components::IRC::UserName>(std::string{nick});
+	indexUser(user.entity(), nick);
+	user.emplace_or_replace<Contact::Components::Name>(std::string{nick});
+
+	return user;
+}
+
+bool IRCClientContactModel::addMember(ContactHandle4 channel, Contact4 user, uint8_t privileges) {
+	auto& subs = channel.get_or_emplace<Contact::Components::ParentOf>().subs;
+	auto& channel_members = channel.get_or_emplace<Contact::Components::IRC::ChannelMembers>();
+	auto& members = channel_members.index;
+
+	if (members.size() != subs.size()) {
+		reindexMembers(subs, channel_members);
+	}
+
+	const auto [it, inserted] = members.try_emplace(user, Contact::Components::IRC::ChannelMembers::Member{subs.size(), privileges});
+	if (!inserted) {
+		return false;
+	}
+
+	subs.push_back(user);
+	addUserChannel(user, channel.entity());
+	updateMemberCount(channel);
+	return true;
+}
+
+bool IRCClientContactModel::removeMember(ContactHandle4 channel, Contact4 user) {
+	auto* parent_of = channel.try_get<Contact::Components::ParentOf>();
+	if (parent_of == nullptr) {
+		return false;
+	}
+	auto& subs = parent_of->subs;
+	auto& channel_members = channel.get_or_emplace<Contact::Components::IRC::ChannelMembers>();
+	auto& members = channel_members.index;
+
+	auto it = members.find(user);
+	if (members.size() != subs.size() || (it != members.end() && (it->second.pos >= subs.size() || subs[it->second.pos] != user))) {
+		reindexMembers(subs, channel_members);
+		it = members.find(user);
+	}
+
+	if (it == members.end()) {
+		return false;
+	}
+
+	// swap-pop
+	const size_t pos = it->second.pos;
+	members.erase(it);
+	if (pos + 1 != subs.size()) {
+		subs[pos] = subs.back();
+		members[subs[pos]].pos = pos;
+	}
+	subs.pop_back();
+
+	removeUserChannel(user, channel.entity());
+	updateMemberCount(channel);
+
+	return true;
+}
+
+bool IRCClientContactModel::clearMembers(ContactHandle4 channel) {
+	bool changed {false};
+
+	if (auto* parent_of = channel.try_get<Contact::Components::ParentOf>(); parent_of != nullptr) {
+		const auto subs = std::move(parent_of->subs);
+		parent_of->subs.clear();
+		for (const auto user : subs) {
+			// requeues them as idle if this was their last channel
+			removeUserChannel(user, channel.entity());
+		}
+		changed = !subs.empty();
+	}
+	channel.emplace_or_replace<Contact::Components::IRC::ChannelMembers>();
+
+	if (const auto it = _lazy_channel_members.find(channel.entity()); it != _lazy_channel_members.end()) {
+		const auto lazy_members = std::move(it->second);
+		_lazy_channel_members.erase(it);
+		for (auto* lazy : lazy_members) {
+			removeLazyMember(channel.entity(), *lazy); // might free lazy, the others stay valid
+		}
+		changed = changed || !lazy_members.empty();
+	}
+
+	return updateMemberCount(channel) || changed;
+}
+
+void IRCClientContactModel::addUserChannel(Contact4 user, Contact4 channel) {
+	auto& cr = _cs.registry();
+	if (!cr.valid(user)) {
+		return;
+	}
+
+	auto& channels = cr.get_or_emplace<Contact::Components::IRC::UserChannels>(user).channels;
+	if (std::find(channels.cbegin(), channels.cend(), channel) == channels.cend()) {
+		channels.push_back(channel);
+	}
+
+	updateIdle(user);
+}
+
+void IRCClientContactModel::removeUserChannel(Contact4 user, Contact4 channel) {
+	auto& cr = _cs.registry();
+	if (!cr.valid(user)) {
+		return;
+	}
+
+	auto* uc = cr.try_get<Contact::Components::IRC::UserChannels>(user);
+	if (uc == nullptr) {
+		return;
+	}
+
+	auto& channels = uc->channels;
+	if (auto it = std::find(channels.begin(), channels.end(), channel); it != channels.end()) {
+		*it = channels.back();
+		channels.pop_back();
+
+		if (channels.empty()) {
+			updateIdle(user);
+		}
+	}
+}
+
+IRCClientContactModel::LazyUser* IRCClientContactModel::findLazyU(std::string_view nick) {
+	const auto it = _lazy_users.find(nameKey(nick));
+	return it != _lazy_users.end() ? &it->second : nullptr;
+}
+
+bool IRCClientContactModel::addLazyMember(Contact4 channel, std::string_view nick, uint8_t privileges) {
+	const auto& key = nameKey(nick);
+	auto it = _lazy_users.find(key);
+	if (it == _lazy_users.end()) {
+		it = _lazy_users.emplace(key, LazyUser{std::string{nick}, {}}).first;
+	}
+	auto& user = it->second;
+
+	// also when known, applyNames() collects the members here
+	_lazy_channel_members[channel].insert(&user);
+
+	for (auto& [c, p] : user.channels) {
+		if (c == channel) {
+			// not visible on any contact, so no change
+			p = privileges;
+			return false;
+		}
+	}
+
+	user.channels.emplace_back(channel, privileges);
+	updateMemberCount(_cs.contactHandle(channel));
+	return true;
+}
+
+bool IRCClientContactModel::removeLazyMember(Contact4 channel, LazyUser& user) {
+	if (const auto it = _lazy_channel_members.find(channel); it != _lazy_channel_members.end()) {
+		it->second.erase(&user);
+	}
+
+	auto& channels = user.channels;
+	const auto it = std::find_if(channels.begin(), channels.end(), [channel](const auto& p) { return p.first == channel; });
+	if (it == channels.end()) {
+		return false;
+	}
+	*it = channels.back();
+	channels.pop_back();
+
+	if (channels.empty()) {
+		// in no channel we know, forget about them
+		_lazy_users.erase(nameKey(user.nick));
+	}
+
+	if (_cs.registry().valid(channel)) {
+		updateMemberCount(_cs.contactHandle(channel));
+	}
+	return true;
+}
+
+void IRCClientContactModel::dropLazyU(LazyUser& user, const IRCClient::Tags& tags) {
+	// frees user with the last channel
+	const auto channels = user.channels;
+	for (const auto& [c, privileges] : channels) {
+		if (removeLazyMember(c, user) && _cs.registry().valid(c)) {
+			contactChanged(c, tags);
+		}
+	}
+}
+
+ContactHandle4 IRCClientContactModel::materializeU(LazyUser& lazy) {
+	for (const auto& [c, privileges] : lazy.channels) {
+		if (const auto it = _lazy_channel_members.find(c); it != _lazy_channel_members.end()) {
+			it->second.erase(&lazy);
+		}
+	}
+	const auto lazy_user = std::move(lazy);
+	_lazy_users.erase(nameKey(lazy_user.nick));
+
+	bool created {false};
+	auto user = makeU(lazy_user.nick, created);
+	user.emplace_or_replace<Contact::Components::ConnectionState>(Contact::Components::ConnectionState::State::cloud);
+	user.emplace_or_replace<Contact::Components::Self>(_self);
+
+	// the member counts stay the same, the contact lists grow
+	const auto& cr = _cs.registry();
+	for (const auto& [c, privileges] : lazy_user.channels) {
+		if (cr.valid(c) && addMember(_cs.contactHandle(c), user, privileges)) {
+			contactChanged(c);
+		}
+	}
+
+	if (created) {
+		contactConstructed(user);
+	} else {
+		contactChanged(user);
+	}
+
+	return user;
+}
+
+bool IRCClientContactModel::updateMemberCount(ContactHandle4 channel) {
+	size_t count {0};
+	if (const auto* parent_of = channel.try_get<Contact::Components::ParentOf>(); parent_of != nullptr) {
+		count += parent_of->subs.size();
+	}
+	if (const auto it = _lazy_channel_members.find(channel.entity()); it != _lazy_channel_members.end()) {
+		count += it->second.size();
+	}
+
+	if (const auto* mc = channel.try_get<Contact::Components::IRC::MemberCount>(); mc != nullptr && mc->count == count) {
+		return false;
+	}
+	channel.emplace_or_replace<Contact::Components::IRC::MemberCount>(count);
+	return true;
+}
+
+void IRCClientContactModel::updateIdle(Contact4 user) {
+	if (_max_idle_users == 0 || user == _self) {
+		return;
+	}
+
+	const auto& cr = _cs.registry();
+	const auto* uc = cr.valid(user) ? cr.try_get<Contact::Components::IRC::UserChannels>(user) : nullptr;
+	const bool idle = cr.valid(user) && (uc == nullptr || uc->channels.empty());
+
+	const auto it = _idle_index.find(user);
+	if (!idle) {
+		if (it != _idle_index.end()) {
+			_idle_users.erase(it->second);
+			_idle_index.erase(it);
+		}
+	} else if (it != _idle_index.end()) {
+		// most recently idle
+		_idle_users.splice(_idle_users.end(), _idle_users, it->second);
+	} else {
+		_idle_index.emplace(user, _idle_users.insert(_idle_users.end(), user));
+	}
+}
+
+void IRCClientContactModel::evictIdleUsers(void) {
+	if (_max_idle_users == 0 || _idle_users.size() <= _max_idle_users) {
+		return;
+	}
+
+	auto& cr = _cs.registry();
+	size_t evicted {0};
+	while (_idle_users.size() > _max_idle_users) {
+		const auto c = _idle_users.front();
+		_idle_users.pop_front();
+		_idle_index.erase(c);
+
+		if (!cr.valid(c) || c == _self) {
+			continue;
+		}
+
+		// kept for the conversation or their messages, no longer tracked
+		// (loaded users with pm history only have TagPrivate)
+		if (cr.any_of<
+			Contact::Components::IRC::PrivateActivity,
+			Contact::Components::IRC::TagMessageAuthor,
+			Contact::Components::TagPrivate
+		>(c)) {
+			continue;
+		}
+
+		// only our users, and only if they are still in no channel
+		const auto* parent = cr.try_get<Contact::Components::Parent>(c);
+		if (parent == nullptr || parent->parent != _server || !cr.all_of<Contact::Components::IRC::UserName>(c)) {
+			continue;
+		}
+		if (const auto* uc = cr.try_get<Contact::Components::IRC::UserChannels>(c); uc != nullptr && !uc->channels.empty()) {
+			continue;
+		}
+
+		_cs.throwEventDestroy(c);
+		cr.destroy(c);
+		evicted++;
+	}
+
+	IRCC_LOG_DEBUG("IRCCCM: evicted " << evicted << " idle users");
+}
+
+void IRCClientContactModel::contactConstructed(Contact4 c) {
+	_update_stats.requested++;
+	markDirty(c, true);
+}
+
+void IRCClientContactModel::contactChanged(Contact4 c) {
+	_update_stats.requested++;
+	markDirty(c, false);
+}
+
+void IRCClientContactModel::contactChanged(Contact4 c, const IRCClient::Tags& tags) {
+	if (const auto batch = tags.get("batch"); batch.has_value()) {
+		if (auto it = _batch_dirty.find(batch.value()); it != _batch_dirty.end()) {
+			_update_stats.requested++;
+			it->second.emplace(c);
+			return;
+		}
+	}
+
+	contactChanged(c);
+}
+
+void IRCClientContactModel::markDirty(Contact4 c, bool constructed) {
+	if (!_deferred_updates) {
+		_update_stats.thrown++;
+		if (constructed) {
+			_cs.throwEventConstruct(c);
+		} else {
+			_cs.throwEventUpdate(c);
+		}
+		return;
+	}
+
+	if (const auto [it, inserted] = _dirty_index.try_emplace(c, _dirty.size()); inserted) {
+		_dirty.emplace_back(c, constructed);
+	} else if (constructed) {
+		// a construct covers the updates before it
+		_dirty.at(it->second).second = true;
+	}
+}
+
+void IRCClientContactModel::flushDirty(void) {
+	if (_dirty.empty()) {
+		return;
+	}
+
+	// listeners might cause more changes
+	const auto dirty = std::move(_dirty);
+	_dirty.clear();
+	_dirty_index.clear();
+
+	const auto& cr = _cs.registry();
+	for (const auto& [c, constructed] : dirty) {
+		if (!cr.valid(c)) {
+			continue;
+		}
+
+		_update_stats.thrown++;
+		if (constructed) {
+			_cs.throwEventConstruct(c);
+		} else {
+			_cs.throwEventUpdate(c);
+		}
+	}
+}
+
+void IRCClientContactModel::applyNames(ContactHandle4 channel, const std::vector<PendingName>& names) {
+	// the complete list replaces the old one, this also drops members we missed leaving (eg. while disconnected)
+	std::vector<Contact4> new_subs;
+	new_subs.reserve(names.size());
+	Contact::Components::IRC::ChannelMembers new_members;
+	new_members.index.reserve(names.size());
+
+	size_t users_created {0};
+	size_t users_updated {0};
+
+	// lazy members are collected anew, the ones left over in old_lazy are gone
+	auto old_lazy = std::move(_lazy_channel_members[channel.entity()]);
+	_lazy_channel_members[channel.entity()].clear();
+	bool lazy_changed {false};
+
+	for (const auto& [user_str, privileges] : names) {
+		auto user = findU(user_str);
+		bool user_updated {false};
+		bool user_created {false};
+		if (!static_cast<bool>(user)) {
+			if (_lazy_members) {
+				lazy_changed = addLazyMember(channel.entity(), user_str, privileges) || lazy_changed;
+				continue;
+			}
+
+			user = makeU(user_str, user_created);
+			user_updated = true;
+		}
+
+		if (user.entity() != _self) {
+			// only touch what changed, so a rejoin does not update every user
+			const auto* cs_comp = user.try_get<Contact::Components::ConnectionState>();
+			if (cs_comp == nullptr || cs_comp->state != Contact::Components::ConnectionState::State::cloud) {
+				user.emplace_or_replace<Contact::Components::ConnectionState>(Contact::Components::ConnectionState::State::cloud);
+				user_updated = true;
+			}
+			const auto* self_comp = user.try_get<Contact::Components::Self>();
+			if (self_comp == nullptr || self_comp->self != _self) {
+				user.emplace_or_replace<Contact::Components::Self>(_self);
+				user_updated = true;
+			}
+		}
+
+		if (new_members.index.try_emplace(user.entity(), Contact::Components::IRC::ChannelMembers::Member{new_subs.size(), privileges}).second) {
+			new_subs.push_back(user.entity());
+		}
+
+		if (user_created) {
+			contactConstructed(user);
+			users_created++;
+		} else if (user_updated) {
+			contactChanged(user);
+			users_updated++;
+		}
+	}
+
+	auto& subs = channel.get_or_emplace<Contact::Components::ParentOf>().subs;
+	const auto* old_members = channel.try_get<Contact::Components::IRC::ChannelMembers>();
+
+	bool members_changed = subs.size() != new_subs.size();
+	for (const auto old_member : subs) {
+		const auto new_it = new_members.index.find(old_member);
+		if (new_it == new_members.index.end()) {
+			members_changed = true;
+			removeUserChannel(old_member, channel.entity());
+		} else if (!members_changed) {
+			// or the privileges
+			if (old_members == nullptr) {
+				members_changed = true;
+			} else {
+				const auto old_it = old_members->index.find(old_member);
+				members_changed = old_it == old_members->index.end() || old_it->second.privileges != new_it->second.privileges;
+			}
+		}
+	}
+	for (const auto new_member : new_subs) {
+		addUserChannel(new_member, channel.entity());
+	}
+
+	const auto& new_lazy = _lazy_channel_members[channel.entity()];
+	for (auto* lazy : old_lazy) {
+		if (new_lazy.count(lazy) == 0) {
+			removeLazyMember(channel.entity(), *lazy);
+			lazy_changed = true;
+		}
+	}
+
+	IRCC_LOG_DEBUG("IRCCCM: names for '" << channel.get<Contact::Components::IRC::ChannelName>().name << "'"
+		<< " members:" << new_subs.size()
+		<< " (was " << subs.size() << ")"
+		<< " lazy members:" << new_lazy.size()
+		<< " new users:" << users_created
+		<< " updated users:" << users_updated
+	);
+
+	subs = std::move(new_subs);
+	channel.emplace_or_replace<Contact::Components::IRC::ChannelMembers>(std::move(new_members));
+	updateMemberCount(channel);
+
+	if (members_changed || lazy_changed) {
+		contactChanged(channel);
+	}
+}
+
+void IRCClientContactModel::rejoin(void) {
+	struct Planned {
+		std::string name;
+		bool favorite {false};
+		uint64_t last_active {0};
+	};
+	std::vector<Planned> planned;
+	std::unordered_set<std::string, NameHash, std::equal_to<>> seen;
+
+	const auto plan = [&](std::string_view name, uint64_t last_active) {
+		if (name.empty() || !seen.emplace(nameKey(name)).second) {
+			return;
+		}
+		planned.push_back(Planned{
+			std::string{name},
+			_conf.get_bool(_ircc.getConfigSection(), "favorite", name).value_or(false),
+			last_active
+		});
+	};
+
+	const auto& cr = _cs.registry();
+	cr.view<Contact::Components::Parent, Contact::Components::IRC::ChannelName>().each([this, &cr, &plan](const auto c, const auto& p_c, const auto& cn_c) {
+		if (p_c.parent != _server) {
+			return;
+		}
+
+		const auto* activity = cr.try_get<Contact::Components::IRC::ChannelActivity>(c);
+		plan(cn_c.name, activity != nullptr ? activity->last_ts : 0);
+	});
+
+	while (!_join_queue.empty()) {
+		plan(_join_queue.front(), 0);
+		_join_queue.pop();
+	}
+
+	if (planned.empty()) {
+		return;
+	}
+
+	// favorites, then most recently active, the rest in the order we know them
+	std::stable_sort(planned.begin(), planned.end(), [](const Planned& a, const Planned& b) {
+		if (a.favorite != b.favorite) {
+			return a.favorite;
+		}
+		return a.last_active > b.last_active;
+	});
+
+	// pack into as few JOINs as the server allows
+	// favorites get their own lines, jumping the bulk queue
+	const auto& isupport = _ircc.getISupport();
+	const size_t max_targets = isupport.targMax(IRCClient::ISupport::Target::join);
+	const size_t max_length = isupport.lineLen() - 2; // crlf
+	const auto& chan_limits = isupport.chanLimits();
+	std::vector<size_t> chan_counts(chan_limits.size(), 0);
+	std::string line;
+	size_t targets {0};
+	bool line_favorite {false};
+	size_t lines {0};
+	size_t skipped {0};
+
+	const auto flush = [&](void) {
+		if (targets == 0) {
+			return;
+		}
+		_ircc.sendRaw(line, line_favorite ? IRCClient::SendPriority::normal : IRCClient::SendPriority::bulk);
+		line.clear();
+		targets = 0;
+		lines++;
+	};
+
+	for (const auto& p : planned) {
+		bool over_limit {false};
+		for (size_t i = 0; i < chan_counts.size(); i++) {
+			const auto& [prefixes, limit] = chan_limits.at(i);
+			if (prefixes.find(p.name.front()) == std::string::npos) {
+				continue;
+			}
+			over_limit = limit != 0 && chan_counts.at(i) >= limit;
+			if (!over_limit) {
+				chan_counts.at(i)++;
+			}
+			break;
+		}
+		if (over_limit) {
+			IRCC_LOG_WARN("IRCCCM: not rejoining '" << p.name << "', over the servers CHANLIMIT");
+			skipped++;
+			continue;
+		}
+
+		// a key (eg. "#chan key") cant be packed with the others
+		const bool has_key = p.name.find(' ') != std::string::npos;
+
+		if (
+			has_key ||
+			line_favorite != p.favorite ||
+			(max_targets != IRCClient::ISupport::unlimited && targets >= max_targets) ||
+			line.size() + 1 + p.name.size() > max_length
+		) {
+			flush();
+		}
+
+		if (targets == 0) {
+			line = "JOIN ";
+			line_favorite = p.favorite;
+		} else {
+			line += ',';
+		}
+		line += p.name;
+		targets++;
+
+		if (has_key) {
+			flush();
+		}
+	}
+	flush();
+
+	IRCC_LOG_INFO("IRCCCM: rejoining " << planned.size() - skipped << " channels with " << lines << " JOINs");
+}
+
 bool IRCClientContactModel::onEvent(const IRCClient::Events::Connect& e) {
 	_server_hash = getHash(_ircc.getServerName());
+	crypto_hash_sha256_init(&_id_hash_state);
+	crypto_hash_sha256_update(&_id_hash_state, _server_hash.data(), _server_hash.size());
+	_id_memo.clear();
 	_connected = true;
 
 	auto& cr = _cs.registry();
 
+	_names_pending.clear();
+
 	bool server_contact_created {false};
 	{ // server
 		if (!cr.valid(_server)) {
@@ -197,6 +910,9 @@ bool IRCClientContactModel::onEvent(const IRCClient::Events::Connect& e) {
 		// TODO: should this be its own node instead? or should the server node be created on construction?
 	}
 
+	// by parent, so needs the server
+	rebuildNameIndex();
+
 	bool self_contact_created {false};
 	{ // self
 		if (!cr.valid(_self)) {
@@ -205,7 +921,7 @@ bool IRCClientContactModel::onEvent(const IRCClient::Events::Connect& e) {
 				const auto self_hash = getIDHash(e.params.front());
 
 				// check for empty contact by id
-				_self = _cs.getOneContactByID(_server, ByteSpan{self_hash});
+				_self = _cs.getOneContactByID(_server, ByteSpan{self_hash.data(), self_hash.size()});
 			}
 			if (!cr.valid(_self)) {
 				_self = cr.create();
@@ -215,21 +931,22 @@ bool IRCClientContactModel::onEvent(const IRCClient::Events::Connect& e) {
 		cr.emplace_or_replace<Contact::Components::ContactModel>(_self, this);
 		cr.emplace_or_replace<Contact::Components::Parent>(_self, _server);
 		cr.emplace_or_replace<Contact::Components::TagSelfStrong>(_self);
-		cr.emplace_or_replace<Contact::Components::IRC::ServerName>(_self, std::string{_ircc.getServerName()}); // really?
 		if (!e.params.empty()) {
 			cr.emplace_or_replace<Contact::Components::IRC::UserName>(_self, std::string{e.params.front()});
+			indexUser(_self, e.params.front());
 			cr.emplace_or_replace<Contact::Components::Name>(_self, std::string{e.params.front()});
 			// make id hash(hash(ServerName)+UserName)
 			// or irc name format, but those might cause collisions
-			cr.emplace_or_replace<Contact::Components::ID>(_self, getIDHash(e.params.front()));
+			const auto self_hash = getIDHash(e.params.front());
+			cr.emplace_or_replace<Contact::Components::ID>(_self, std::vector<uint8_t>{self_hash.cbegin(), self_hash.cend()});
 
 #if 0
-			std::cout << "### created self with"
+			IRCC_LOG_DEBUG("### created self with"
 				<< " e:" << entt::to_integral(_self)
 				<< " ircn:" << _cr.get<Contact::Components::IRC::UserName>(_self).name
-				<< " ircsn:" << _cr.get<Contact::Components::IRC::ServerName>(_self).name
+				<< " ircsn:" << _ircc.getServerName()
 				<< " id:" << bin2hex(_cr.get<Contact::Components::ID>(_self).data)
-				<< "\n";
+			);
 #endif
 		}
 
@@ -239,46 +956,19 @@ bool IRCClientContactModel::onEvent(const IRCClient::Events::Connect& e) {
 		cr.emplace_or_replace<Contact::Components::Self>(_server, _self);
 	}
 
-	// check for preexisting channels,
-	// since this might be a reconnect
-	// and reissue joins
-	cr.view<Contact::Components::IRC::ServerName, Contact::Components::IRC::ChannelName>().each([this](const auto c, const auto& sn_c, const auto& cn_c) {
-		// HACK: by name
-		// should be by parent instead
-		if (sn_c.name != _ircc.getServerName()) {
-			return;
-		}
-
-		// TODO: implement join lol
-		irc_cmd_join(
-			_ircc.getSession(),
-			cn_c.name.c_str(),
-			""
-		);
-	});
-
-	// join queued
-	// TODO: merge with above
-	while (!_join_queue.empty()) {
-		// TODO: implement join lol
-		irc_cmd_join(
-			_ircc.getSession(),
-			_join_queue.front().c_str(),
-			""
-		);
-		_join_queue.pop();
-	}
+	// preexisting channels (this might be a reconnect) and queued joins
+	rejoin();
 
 	if (server_contact_created) {
-		_cs.throwEventConstruct(_server);
+		contactConstructed(_server);
 	} else {
-		_cs.throwEventUpdate(_server);
+		contactChanged(_server);
 	}
 
 	if (self_contact_created) {
-		_cs.throwEventConstruct(_self);
+		contactConstructed(_self);
 	} else {
-		_cs.throwEventUpdate(_self);
+		contactChanged(_self);
 	}
 
 	return false;
@@ -302,17 +992,23 @@ bool IRCClientContactModel::onEvent(const IRCClient::Events::Numeric& e) {
 			e.params.at(1) != "@" && // Secret channel
 			e.params.at(1) != "*" // Private channel
 		) {
-			std::cerr << "IRCCCM error: name list for unknown channel type\n";
+			IRCC_LOG_ERROR("IRCCCM error: name list for unknown channel type");
 			return false;
 		}
 
 		const auto& channel_name = e.params.at(2);
-		auto channel = getC(channel_name);
-		if (!static_cast<bool>(channel)) {
-			std::cerr << "IRCCCM error: name list for unknown channel\n";
+		if (!static_cast<bool>(getC(channel_name))) {
+			IRCC_LOG_ERROR("IRCCCM error: name list for unknown channel");
 			return false;
 		}
 
+		// collected until RPL_ENDOFNAMES
+		auto pending_it = _names_pending.find(nameKey(channel_name));
+		if (pending_it == _names_pending.end()) {
+			pending_it = _names_pending.emplace(nameKey(channel_name), std::vector<PendingName>{}).first;
+		}
+		auto& pending = pending_it->second;
+
 		std::string_view user_list = e.params.at(3);
 
 		std::string_view::size_type space_pos;
@@ -327,83 +1023,23 @@ bool IRCClientContactModel::onEvent(const IRCClient::Events::Numeric& e) {
 				// channel.
 
 				if (user_str.empty()) {
-					std::cerr << "IRCCCM error: empty user\n";
+					IRCC_LOG_ERROR("IRCCCM error: empty user");
 					break;
 				}
 
 				// https://modern.ircdocs.horse/#channel-membership-prefixes
-				static constexpr std::string_view membership_prefixes{
-					"~" // founder
-					"&" // protected
-					"@" // operator
-					"%" // half operator
-					"+" // voice
-				};
-				if (membership_prefixes.find(user_str.front()) != std::string_view::npos) {
-					switch (user_str.front()) {
-						// TODO: use this info
-						case '~': break;
-						case '&': break;
-						case '@': break;
-						case '%': break;
-						case '+': break;
-					}
-					user_str = user_str.substr(1);
-				}
+				// as advertised in PREFIX, with multi-prefix there can be more than one
+				const uint8_t privileges = _ircc.getISupport().channelModes().stripPrefixes(user_str);
+
+				// userhost-in-names sends nick!user@host
+				user_str = user_str.substr(0, user_str.find_first_of("!@"));
 
 				if (user_str.empty()) {
-					std::cerr << "IRCCCM error: empty user after removing membership prefix\n";
+					IRCC_LOG_ERROR("IRCCCM error: empty user after removing membership prefix");
 					break;
 				}
 
-				//std::cout << "u: " << user_str << "\n";
-
-				auto user = getU(user_str);
-				bool user_throw_event {false};
-				bool user_created {false};
-				if (!static_cast<bool>(user)) {
-					const auto user_hash = getIDHash(user_str);
-					// check for empty contact by id
-					user = _cs.getOneContactByID(_server, ByteSpan{user_hash});
-					if (!static_cast<bool>(user)) {
-						user = _cs.contactHandle(_cs.registry().create());
-						user_created = true;
-						user.emplace_or_replace<Contact::Components::ID>(user_hash);
-					}
-
-					user.emplace_or_replace<Contact::Components::ContactModel>(this);
-					user.emplace_or_replace<Contact::Components::IRC::ServerName>(std::string{_ircc.getServerName()});
-					// channel list?
-					// add to channel?
-					user.emplace_or_replace<Contact::Components::IRC::UserName>(std::string{user_str});
-					user.emplace_or_replace<Contact::Components::Name>(std::string{user_str});
-
-					user_throw_event = true;
-				}
-
-				if (user.entity() != _self) {
-					user.emplace_or_replace<Contact::Components::ConnectionState>(Contact::Components::ConnectionState::State::cloud);
-					user.emplace_or_replace<Contact::Components::Self>(_self);
-
-					user_throw_event = true;
-				}
-
-				{ // add user to channel
-					auto& channel_user_list = channel.get_or_emplace<Contact::Components::ParentOf>().subs;
-					if (std::find(channel_user_list.begin(), channel_user_list.end(), user) == channel_user_list.end()) {
-						//std::cout << "!!!!!!!! new user in channel!\n";
-						channel_user_list.push_back(user);
-						user_throw_event = true;
-					}
-				}
-
-				if (user_throw_event) {
-					if (user_created) {
-						_cs.throwEventConstruct(user);
-					} else {
-						_cs.throwEventUpdate(user);
-					}
-				}
+				pending.push_back(PendingName{std::string{user_str}, privileges});
 			}
 
 			if (space_pos == std::string_view::npos) {
@@ -418,6 +1054,28 @@ bool IRCClientContactModel::onEvent(const IRCClient::Events::Numeric& e) {
 			}
 			user_list = user_list.substr(next_non_space);
 		} while (space_pos != std::string_view::npos);
+	} else if (e.event == LIBIRC_RFC_RPL_ENDOFNAMES) {
+		// e.params.at(0) user (self)
+		// e.params.at(1) channel
+		// e.params.at(2) "End of /NAMES list."
+		if (e.params.size() < 2) {
+			return false;
+		}
+
+		auto pending_it = _names_pending.find(nameKey(e.params.at(1)));
+		if (pending_it == _names_pending.end()) {
+			// eg. empty reply for a channel we are not in
+			return false;
+		}
+		const auto names = std::move(pending_it->second);
+		_names_pending.erase(pending_it);
+
+		auto channel = getC(e.params.at(1));
+		if (!static_cast<bool>(channel)) {
+			return false;
+		}
+
+		applyNames(channel, names);
 	} else if (e.event == LIBIRC_RFC_RPL_TOPIC) {
 		// origin is the server
 		// params.at(0) is the user (self)
@@ -433,13 +1091,13 @@ bool IRCClientContactModel::onEvent(const IRCClient::Events::Numeric& e) {
 		const auto channel_name = e.params.at(1);
 		auto channel = getC(channel_name);
 		if (!static_cast<bool>(channel)) {
-			std::cerr << "IRCCCM error: topic for unknown channel\n";
+			IRCC_LOG_ERROR("IRCCCM error: topic for unknown channel");
 			return false;
 		}
 
 		const auto topic = e.params.at(2);
 		channel.emplace_or_replace<Contact::Components::StatusText>(std::string{topic}).fillFirstLineLength();
-		_cs.throwEventUpdate(channel);
+		contactChanged(channel);
 	}
 	return false;
 }
@@ -460,22 +1118,24 @@ bool IRCClientContactModel::onEvent(const IRCClient::Events::Join& e) {
 	if (!static_cast<bool>(channel)) {
 		const auto channel_hash = getIDHash(joined_channel_name);
 		// check for empty contact by id
-		channel = _cs.getOneContactByID(_server, ByteSpan{channel_hash});
+		channel = _cs.getOneContactByID(_server, ByteSpan{channel_hash.data(), channel_hash.size()});
 		if (!static_cast<bool>(channel)) {
 			//channel = {_cr, _cr.create()};
 			channel = _cs.contactHandle(cr.create());
 			channel_created = true;
-			channel.emplace_or_replace<Contact::Components::ID>(channel_hash);
+			channel.emplace_or_replace<Contact::Components::ID>(std::vector<uint8_t>{channel_hash.cbegin(), channel_hash.cend()});
 		}
 		channel.emplace_or_replace<Contact::Components::ContactModel>(this);
 		channel.emplace_or_replace<Contact::Components::Parent>(_server);
 		cr.get_or_emplace<Contact::Components::ParentOf>(_server).subs.push_back(channel);
 		channel.emplace_or_replace<Contact::Components::ParentOf>(); // start empty
-		channel.emplace_or_replace<Contact::Components::IRC::ServerName>(std::string{_ircc.getServerName()});
+		channel.emplace_or_replace<Contact::Components::IRC::ChannelMembers>();
+		updateMemberCount(channel);
 		channel.emplace_or_replace<Contact::Components::IRC::ChannelName>(std::string{joined_channel_name});
+		indexChannel(channel.entity(), joined_channel_name);
 		channel.emplace_or_replace<Contact::Components::Name>(std::string{joined_channel_name});
 
-		std::cout << "IRCCCM: joined '" << joined_channel_name << "' id:" << bin2hex(channel.get<Contact::Components::ID>().data) << "\n";
+		IRCC_LOG_INFO("IRCCCM: joined '" << joined_channel_name << "' id:" << bin2hex(channel.get<Contact::Components::ID>().data));
 
 		channel.emplace_or_replace<Contact::Components::TagBig>();
 		channel.emplace_or_replace<Contact::Components::TagGroup>();
@@ -486,41 +1146,49 @@ bool IRCClientContactModel::onEvent(const IRCClient::Events::Join& e) {
 	channel.emplace_or_replace<Contact::Components::ConnectionState>(Contact::Components::ConnectionState::State::cloud);
 
 	if (channel_created) {
-		_cs.throwEventConstruct(channel);
+		contactConstructed(channel);
 	} else {
-		_cs.throwEventUpdate(channel);
+		contactChanged(channel, e.tags);
+	}
+
+	auto user = findU(e.origin);
+	if (!static_cast<bool>(user) && _lazy_members) {
+		// we always have a contact for ourselves, so this is someone else
+		if (addLazyMember(channel.entity(), e.origin, 0)) {
+			contactChanged(channel, e.tags);
+		}
+		return false;
 	}
 
-	auto user = getU(e.origin);
 	bool user_throw_event {false};
 	bool user_created {false};
 	if (!static_cast<bool>(user)) {
 		const auto user_hash = getIDHash(e.origin);
 		// check for empty contact by id
-		user = _cs.getOneContactByID(_server, ByteSpan{user_hash});
+		user = _cs.getOneContactByID(_server, ByteSpan{user_hash.data(), user_hash.size()});
 		if (!static_cast<bool>(user)) {
 			user = _cs.contactHandle(cr.create());
 			user_created = true;
-			user.emplace_or_replace<Contact::Components::ID>(user_hash);
-			std::cerr << "IRCCCM error: had to create joining user (self?)\n";
+			user.emplace_or_replace<Contact::Components::ID>(std::vector<uint8_t>{user_hash.cbegin(), user_hash.cend()});
+			IRCC_LOG_ERROR("IRCCCM error: had to create joining user (self?)");
 		}
 
 		user.emplace_or_replace<Contact::Components::ContactModel>(this);
 		user.emplace_or_replace<Contact::Components::Parent>(_server);
-		user.emplace_or_replace<Contact::Components::IRC::ServerName>(std::string{_ircc.getServerName()});
 		// channel list?
 		// add to channel?
 		user.emplace_or_replace<Contact::Components::IRC::UserName>(std::string{e.origin});
+		indexUser(user.entity(), e.origin);
 		user.emplace_or_replace<Contact::Components::Name>(std::string{e.origin});
 
 		user_throw_event = true;
 
 		// ???
-		std::cout << "### created self(?) with"
+		IRCC_LOG_DEBUG("### created self(?) with"
 			<< " ircn:" << cr.get<Contact::Components::IRC::UserName>(_self).name
-			<< " ircsn:" << cr.get<Contact::Components::IRC::ServerName>(_self).name
+			<< " ircsn:" << _ircc.getServerName()
 			<< " id:" << bin2hex(cr.get<Contact::Components::ID>(_self).data)
-			<< "\n";
+		);
 	}
 
 	if (user.entity() != _self) {
@@ -531,19 +1199,14 @@ bool IRCClientContactModel::onEvent(const IRCClient::Events::Join& e) {
 
 	if (user_throw_event) {
 		if (user_created) {
-			_cs.throwEventConstruct(user);
+			contactConstructed(user);
 		} else {
-			_cs.throwEventUpdate(user);
+			contactChanged(user, e.tags);
 		}
 	}
 
-	{ // add user to channel
-		auto& channel_user_list = channel.get_or_emplace<Contact::Components::ParentOf>().subs;
-		if (std::find(channel_user_list.begin(), channel_user_list.end(), user) == channel_user_list.end()) {
-			//std::cout << "!!!!!!!! new user in channel!\n";
-			channel_user_list.push_back(user);
-			_cs.throwEventUpdate(channel);
-		}
+	if (addMember(channel, user)) {
+		contactChanged(channel, e.tags);
 	}
 
 	return false;
@@ -556,10 +1219,18 @@ bool IRCClientContactModel::onEvent(const IRCClient::Events::Part& e) {
 	}
 
 	// e.origin // is the parting user
-	auto user = getU(e.origin);
+	auto user = findU(e.origin);
 	if (!static_cast<bool>(user)) {
+		if (auto* lazy = findLazyU(e.origin); lazy != nullptr) {
+			auto channel = getC(e.params.front());
+			if (static_cast<bool>(channel) && removeLazyMember(channel.entity(), *lazy)) {
+				contactChanged(channel, e.tags);
+			}
+			return false;
+		}
+
 		// ignoring unknown users, might be caused by a bug
-		std::cerr << "ignoring unknown users, might be caused by a bug\n";
+		IRCC_LOG_WARN("IRCCCM: ignoring unknown users, might be caused by a bug");
 		return false;
 	}
 
@@ -567,22 +1238,132 @@ bool IRCClientContactModel::onEvent(const IRCClient::Events::Part& e) {
 	auto channel = getC(e.params.front());
 	if (!static_cast<bool>(channel)) {
 		// ignoring unknown channel, might be caused by a bug
-		std::cerr << "ignoring unknown channel, might be caused by a bug\n";
+		IRCC_LOG_WARN("IRCCCM: ignoring unknown channel, might be caused by a bug");
 		return false;
 	}
 
-	{ // remove user from channel
-		auto& channel_user_list = channel.get_or_emplace<Contact::Components::ParentOf>().subs;
-		if (auto it = std::find(channel_user_list.begin(), channel_user_list.end(), user); it != channel_user_list.end()) {
-			//std::cout << "!!!!!!!! removing user from channel!\n";
-			channel_user_list.erase(it);
-			_cs.throwEventUpdate(channel);
-		} else {
-			//std::cout << "!!!!!!!! unknown user leaving channel!\n";
+	if (user.entity() == _self) {
+		// we no longer see the channel, forget the members until we rejoin
+		if (clearMembers(channel)) {
+			contactChanged(channel, e.tags);
 		}
+	} else if (removeMember(channel, user)) {
+		contactChanged(channel, e.tags);
 	}
 
-	_cs.throwEventUpdate(user); // ??
+	contactChanged(user, e.tags); // ??
+
+	return false;
+}
+
+bool IRCClientContactModel::onEvent(const IRCClient::Events::Mode& e) {
+	// e.origin is the setter
+	// e.params.at(0) is the channel
+	// e.params.at(1) is the mode string, eg. "+o-v"
+	// then the arguments, in order
+	if (e.params.size() < 2) {
+		return false;
+	}
+
+	auto channel = getC(e.params.at(0));
+	if (!static_cast<bool>(channel)) {
+		return false;
+	}
+
+	auto* channel_members = channel.try_get<Contact::Components::IRC::ChannelMembers>();
+	if (channel_members == nullptr) {
+		return false;
+	}
+
+	bool changed {false};
+	const auto& channel_modes = _ircc.getISupport().channelModes();
+	const bool complete = channel_modes.decode(
+		e.params.at(1),
+		IRCClient::Params{e.params.begin() + 2, e.params.size() - 2},
+		[&](const IRCClient::ChannelModes::Change& change) {
+			const uint8_t privilege = channel_modes.modePrivilege(change.mode);
+			if (privilege == 0) {
+				// TODO: other channel modes
+				return;
+			}
+
+			const auto user = findU(change.arg);
+			if (!static_cast<bool>(user)) {
+				// not visible on any contact, so no change
+				if (auto* lazy = findLazyU(change.arg); lazy != nullptr) {
+					for (auto& [c, privileges] : lazy->channels) {
+						if (c != channel.entity()) {
+							continue;
+						}
+						if (change.set) {
+							privileges |= privilege;
+						} else {
+							privileges &= ~privilege;
+						}
+					}
+				}
+				return;
+			}
+
+			const auto it = channel_members->index.find(user.entity());
+			if (it == channel_members->index.end()) {
+				return;
+			}
+
+			const uint8_t old_privileges = it->second.privileges;
+			if (change.set) {
+				it->second.privileges |= privilege;
+			} else {
+				it->second.privileges &= ~privilege;
+			}
+			changed = changed || old_privileges != it->second.privileges;
+		}
+	);
+	if (!complete) {
+		IRCC_LOG_WARN("IRCCCM: mode change with missing arguments '" << e.params.at(1) << "'");
+	}
+
+	if (changed) {
+		contactChanged(channel, e.tags);
+	}
+
+	return false;
+}
+
+bool IRCClientContactModel::onEvent(const IRCClient::Events::Kick& e) {
+	// e.origin is the kicker
+	// e.params.at(0) is the channel
+	// e.params.at(1) is the kicked user
+	// e.params.at(2) is the optional reason
+	if (e.params.size() < 2) {
+		return false;
+	}
+
+	auto channel = getC(e.params.at(0));
+	if (!static_cast<bool>(channel)) {
+		IRCC_LOG_WARN("IRCCCM: ignoring kick in unknown channel");
+		return false;
+	}
+
+	auto user = findU(e.params.at(1));
+	if (!static_cast<bool>(user)) {
+		if (auto* lazy = findLazyU(e.params.at(1)); lazy != nullptr && removeLazyMember(channel.entity(), *lazy)) {
+			contactChanged(channel, e.tags);
+		}
+		return false;
+	}
+
+	if (user.entity() == _self) {
+		// we are out, until we rejoin
+		channel.emplace_or_replace<Contact::Components::ConnectionState>(Contact::Components::ConnectionState::State::disconnected);
+		clearMembers(channel);
+		contactChanged(channel);
+		return false;
+	}
+
+	if (removeMember(channel, user)) {
+		contactChanged(channel, e.tags);
+	}
 
 	return false;
 }
@@ -601,13 +1382,13 @@ bool IRCClientContactModel::onEvent(const IRCClient::Events::Topic& e) {
 	const auto channel_name = e.params.at(0);
 	auto channel = getC(channel_name);
 	if (!static_cast<bool>(channel)) {
-		std::cerr << "IRCCCM error: new topic for unknown channel\n";
+		IRCC_LOG_ERROR("IRCCCM error: new topic for unknown channel");
 		return false;
 	}
 
 	const auto topic = e.params.at(1);
 	channel.emplace_or_replace<Contact::Components::StatusText>(std::string{topic}).fillFirstLineLength();
-	_cs.throwEventUpdate(channel);
+	contactChanged(channel);
 	return false;
 }
 
@@ -616,19 +1397,179 @@ bool IRCClientContactModel::onEvent(const IRCClient::Events::Quit& e) {
 
 	// e.params.front() is the quit reason
 
-	auto user = getU(e.origin);
+	// a KILL of someone else also reaches us as a QUIT
+	// during a netsplit these come in bulk, ideally in a netsplit batch
+
+	auto user = findU(e.origin);
 	if (!static_cast<bool>(user)) {
+		if (auto* lazy = findLazyU(e.origin); lazy != nullptr) {
+			dropLazyU(*lazy, e.tags);
+		}
 		// ignoring unknown users, might be caused by a bug
 		return false;
 	}
 
 	if (user.entity() != _self) {
 		user.emplace_or_replace<Contact::Components::ConnectionState>(Contact::Components::ConnectionState::State::disconnected);
+
+		// leave only the channels the user was in
+		if (auto* uc = user.try_get<Contact::Components::IRC::UserChannels>(); uc != nullptr) {
+			const auto channels = std::move(uc->channels);
+			uc->channels.clear();
+
+			const auto& cr = _cs.registry();
+			for (const auto c : channels) {
+				if (cr.valid(c) && removeMember(_cs.contactHandle(c), user)) {
+					contactChanged(c, e.tags);
+				}
+			}
+		}
+
+		updateIdle(user);
+	}
+
+	contactChanged(user, e.tags);
+
+	return false;
+}
+
+bool IRCClientContactModel::onEvent(const IRCClient::Events::Nick& e) {
+	// e.origin is the old nick
+	// e.params.front() is the new nick
+	//
+	// the ID follows the nick (hash(hash(ServerName)+UserName)), like for every other user,
+	// but renames never create contacts:
+	// - if a contact for the new nick exists already (eg. changing back), the user continues as that contact
+	// - otherwise the contact is renamed in place
+	// - a change in case only finds the same contact, and is a rename in place
+	// our own contact is always renamed in place and keeps the ID it got on connect,
+	// a contact that already has the new nick (eg. someone we talked to before) keeps its ID, so they never collide
+	if (e.params.empty() || e.params.front().empty()) {
+		return false;
+	}
+
+	const auto new_nick = e.params.front();
+	if (new_nick == e.origin) {
+		return false;
+	}
+
+	auto user = findU(e.origin);
+	if (!static_cast<bool>(user)) {
+		auto* lazy = findLazyU(e.origin);
+		if (lazy == nullptr) {
+			return false;
+		}
+
+		// lazy users stay lazy, unless the new nick has a contact
+		if (auto existing = findU(new_nick); static_cast<bool>(existing) && existing.entity() != _self) {
+			existing.emplace_or_replace<Contact::Components::ConnectionState>(Contact::Components::ConnectionState::State::cloud);
+			existing.emplace_or_replace<Contact::Components::Self>(_self);
+
+			// frees lazy with the last channel
+			const auto channels = lazy->channels;
+			const auto& cr = _cs.registry();
+			for (const auto& [c, privileges] : channels) {
+				removeLazyMember(c, *lazy);
+				if (cr.valid(c) && addMember(_cs.contactHandle(c), existing, privileges)) {
+					contactChanged(c, e.tags);
+				}
+			}
+
+			contactChanged(existing, e.tags);
+			return false;
+		}
+
+		if (auto* taken = findLazyU(new_nick); taken != nullptr && taken != lazy) {
+			// stale, eg. a quit we missed
+			dropLazyU(*taken, e.tags);
+		}
+
+		// the node (and the pointers to it) survives the rekey
+		auto node = _lazy_users.extract(nameKey(e.origin));
+		node.key() = nameKey(new_nick);
+		node.mapped().nick = std::string{new_nick};
+		_lazy_users.insert(std::move(node));
+
+		return false;
+	}
+
+	ContactHandle4 existing;
+	if (user.entity() == _self) {
+		// the server gave us the nick, so a lazy user with it is stale
+		if (auto* taken = findLazyU(new_nick); taken != nullptr) {
+			dropLazyU(*taken, e.tags);
+		}
+	} else {
+		// a lazy user with the new nick is stale (eg. a quit we missed), getU() makes it the contact we continue as
+		existing = getU(new_nick);
+		if (!static_cast<bool>(existing)) {
+			const auto new_hash = getIDHash(new_nick);
+			existing = _cs.getOneContactByID(_server, ByteSpan{new_hash.data(), new_hash.size()});
+			if (static_cast<bool>(existing) && !existing.all_of<Contact::Components::IRC::UserName>()) {
+				// not one of our users
+				existing = {};
+			}
+		}
+	}
+
+	if (static_cast<bool>(existing) && existing.entity() != user.entity()) {
+		// move the user over
+		if (existing.entity() != _self) {
+			existing.emplace_or_replace<Contact::Components::ConnectionState>(Contact::Components::ConnectionState::State::cloud);
+			existing.emplace_or_replace<Contact::Components::Self>(_self);
+			existing.emplace_or_replace<Contact::Components::IRC::UserName>(std::string{new_nick});
+			existing.emplace_or_replace<Contact::Components::Name>(std::string{new_nick});
+		}
+		indexUser(existing.entity(), new_nick);
+
+		user.emplace_or_replace<Contact::Components::ConnectionState>(Contact::Components::ConnectionState::State::disconnected);
+
+		if (auto* uc = user.try_get<Contact::Components::IRC::UserChannels>(); uc != nullptr) {
+			const auto channels = std::move(uc->channels);
+			uc->channels.clear();
+
+			const auto& cr = _cs.registry();
+			for (const auto c : channels) {
+				if (!cr.valid(c)) {
+					continue;
+				}
+				auto channel = _cs.contactHandle(c);
+
+				// the privileges stay with the nick
+				uint8_t privileges {0};
+				if (const auto* members = channel.try_get<Contact::Components::IRC::ChannelMembers>(); members != nullptr) {
+					if (const auto it = members->index.find(user.entity()); it != members->index.end()) {
+						privileges = it->second.privileges;
+					}
+				}
+
+				removeMember(channel, user);
+				addMember(channel, existing, privileges);
+				contactChanged(c, e.tags);
+			}
+		}
+		updateIdle(user.entity());
+
+		contactChanged(existing, e.tags);
+		contactChanged(user, e.tags);
+
+		return false;
 	}
 
-	// should we remove the user from the channel?
+	// rename in place, membership stays as is
+	if (auto it = _user_index.find(nameKey(e.origin)); it != _user_index.end() && it->second == user.entity()) {
+		_user_index.erase(it);
+	}
 
-	_cs.throwEventUpdate(user);
+	if (user.entity() != _self) {
+		const auto new_hash = getIDHash(new_nick);
+		user.emplace_or_replace<Contact::Components::ID>(std::vector<uint8_t>{new_hash.cbegin(), new_hash.cend()});
+	}
+	user.emplace_or_replace<Contact::Components::IRC::UserName>(std::string{new_nick});
+	user.emplace_or_replace<Contact::Components::Name>(std::string{new_nick});
+	indexUser(user.entity(), new_nick);
+
+	contactChanged(user, e.tags);
 
 	return false;
 }
@@ -645,35 +1586,65 @@ bool IRCClientContactModel::onEvent(const IRCClient::Events::CTCP_Req& e) {
 	return false;
 }
 
-bool IRCClientContactModel::onEvent(const IRCClient::Events::Disconnect&) {
-	_connected = false;
-	auto& cr = _cs.registry();
-	if (!cr.valid(_server)) {
-		// skip if where already offline
+bool IRCClientContactModel::onEvent(const IRCClient::Events::Batch& e) {
+	if (e.params.empty() || e.params.front().size() < 2) {
 		return false;
 	}
-	cr.get<Contact::Components::ConnectionState>(_server).state = Contact::Components::ConnectionState::disconnected;
 
-	// HACK: by name
-	ContactHandle4 server;
-	cr.view<Contact::Components::IRC::ServerName, Contact::Components::ConnectionState>().each([this, &server](const auto c, const auto& sn_c, auto&) {
-		// HACK: by name
-		// should be by parent instead
-		if (sn_c.name != _ircc.getServerName()) {
-			return;
+	const auto ref = e.params.front().substr(1);
+	if (e.params.front().front() == '+') {
+		_batch_dirty.try_emplace(std::string{ref});
+	} else if (e.params.front().front() == '-') {
+		auto it = _batch_dirty.find(ref);
+		if (it == _batch_dirty.end()) {
+			return false;
 		}
 
-		server = _cs.contactHandle(c);
-	});
+		const auto dirty = std::move(it->second);
+		_batch_dirty.erase(it);
+
+		const auto& cr = _cs.registry();
+		for (const auto c : dirty) {
+			if (cr.valid(c)) {
+				markDirty(c, false);
+			}
+		}
+	}
 
-	if (!static_cast<bool>(server)) {
+	return false;
+}
+
+bool IRCClientContactModel::onEvent(const IRCClient::Events::Disconnect&) {
+	_connected = false;
+	_names_pending.clear();
+
+	{ // batches wont end now
+		const auto& cr = _cs.registry();
+		for (const auto& [ref, dirty] : _batch_dirty) {
+			for (const auto c : dirty) {
+				if (cr.valid(c)) {
+					markDirty(c, false);
+				}
+			}
+		}
+		_batch_dirty.clear();
+	}
+	auto& cr = _cs.registry();
+	if (!cr.valid(_server)) {
+		// skip if where already offline
 		return false;
 	}
+	cr.get_or_emplace<Contact::Components::ConnectionState>(_server).state = Contact::Components::ConnectionState::disconnected;
 
-	server.get_or_emplace<Contact::Components::ConnectionState>().state = Contact::Components::ConnectionState::disconnected;
+	contactChanged(_server);
 
-	_cs.throwEventUpdate(server);
+	return false;
+}
 
+bool IRCClientContactModel::onEvent(const IRCClient::Events::DispatchDone&) {
+	flushDirty();
+	// after the updates, listeners might still look at the users
+	evictIdleUsers();
 	return false;
 }
 
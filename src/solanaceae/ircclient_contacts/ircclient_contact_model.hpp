@@ -7,12 +7,23 @@
 
 #include <entt/entity/entity.hpp>
 
+#include <sodium/crypto_hash_sha256.h>
+
 #include <vector>
+#include <array>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
 #include <queue>
+#include <list>
+#include <utility>
 #include <cstdint>
 
 class IRCClientContactModel : public IRCClientEventI, public ContactModel4I {
+	using IDHash = std::array<uint8_t, crypto_hash_sha256_BYTES>;
+
 	ContactStore4I& _cs;
 	ConfigModelI& _conf;
 	IRCClient1& _ircc;
@@ -22,12 +33,78 @@ class IRCClientContactModel : public IRCClientEventI, public ContactModel4I {
 	bool _connected {false};
 
 	std::vector<uint8_t> _server_hash; // cached for id gen
+	crypto_hash_sha256_state _id_hash_state {}; // already fed _server_hash, copied for each id
 	Contact4 _server {entt::null};
 	Contact4 _self {entt::null};
 
 	// used if not connected
 	std::queue<std::string> _join_queue;
 
+	// name -> contact for this server, so getC()/getU() dont scan the registry
+	// filled where the model sets ChannelName/UserName and rebuilt on connect,
+	// destroyed components are dropped via the registry signals
+	// entries are checked on lookup, so a stale one is a miss, never a wrong contact
+	// keys are folded by the servers CASEMAPPING, so "#Foo" and "#foo" are one probe for one contact
+	struct NameHash {
+		using is_transparent = void;
+		size_t operator()(std::string_view sv) const { return std::hash<std::string_view>{}(sv); }
+	};
+	using NameIndex = std::unordered_map<std::string, Contact4, NameHash, std::equal_to<>>;
+	NameIndex _channel_index;
+	NameIndex _user_index;
+	std::string _name_key; // scratch for nameKey()
+
+	// name -> id, for names we hashed recently, cleared when full
+	std::unordered_map<std::string, IDHash, NameHash, std::equal_to<>> _id_memo;
+	static constexpr size_t _id_memo_max {4096};
+
+	// open ircv3 batches (eg. netsplit) -> contacts to update once the batch ends
+	std::unordered_map<std::string, std::unordered_set<Contact4>, NameHash, std::equal_to<>> _batch_dirty;
+
+	// channel -> nicks from RPL_NAMREPLY, applied at RPL_ENDOFNAMES
+	struct PendingName {
+		std::string nick;
+		uint8_t privileges {0};
+	};
+	std::unordered_map<std::string, std::vector<PendingName>, NameHash, std::equal_to<>> _names_pending;
+
+	// config "lazy_members", for very large channels
+	// nicks we only know from channel membership get no contact, just an entry here,
+	// until they speak or getU() asks for them
+	// ParentOf/ChannelMembers then only list members with a contact, MemberCount has the total
+	bool _lazy_members {false};
+	struct LazyUser {
+		std::string nick; // as the server sent it
+		std::vector<std::pair<Contact4, uint8_t>> channels; // channel, privileges, few per user
+	};
+	std::unordered_map<std::string, LazyUser, NameHash, std::equal_to<>> _lazy_users; // folded nick ->
+	std::unordered_map<Contact4, std::unordered_set<LazyUser*>> _lazy_channel_members; // channel -> (nodes are stable)
+
+	// config "max_idle_users", 0 is no limit
+	// users that share no channel with us, least recently idle first
+	// over the limit, the oldest are destroyed at the end of the round,
+	// unless something still refers to them (PrivateActivity, TagMessageAuthor, TagPrivate)
+	size_t _max_idle_users {0};
+	std::list<Contact4> _idle_users;
+	std::unordered_map<Contact4, std::list<Contact4>::iterator> _idle_index;
+
+	// config "deferred_contact_updates", off by default:
+	// contacts constructed/changed this round, thrown once each on DispatchDone, in order
+	// saves a lot of events on bursts (names, netsplits), but changes the ordering,
+	// listeners might see a new contact (or its messages) before its construct event
+	bool _deferred_updates {false};
+	std::vector<std::pair<Contact4, bool>> _dirty; // contact, constructed
+	std::unordered_map<Contact4, size_t> _dirty_index;
+
+	public:
+		struct UpdateStats {
+			uint64_t requested {0}; // constructs + updates the event handlers asked for
+			uint64_t thrown {0}; // actually thrown on the contact store
+		};
+
+	private:
+		UpdateStats _update_stats;
+
 	public:
 		IRCClientContactModel(
 			ContactStore4I& cs,
@@ -49,25 +126,90 @@ class IRCClientContactModel : public IRCClientEventI, public ContactModel4I {
 	private:
 		// just the hash algo
 		std::vector<uint8_t> getHash(std::string_view value);
-		std::vector<uint8_t> getHash(const std::vector<uint8_t>& value);
 
 	public:
 		// the actually ID is a chain containing the server+channel or server+name
 		// eg: hash(hash(ServerName)+ChannelName)
-		std::vector<uint8_t> getIDHash(std::string_view name);
+		// the name is hashed as the server sent it (not folded), so ids stay what older versions stored,
+		// the folded index is checked first, so another casing still finds the same contact
+		// no allocation, besides the memo
+		IDHash getIDHash(std::string_view name);
 
 		ContactHandle4 getC(std::string_view channel);
+		// with lazy_members, a nick we only know from a channel gets its contact here
 		ContactHandle4 getU(std::string_view nick);
 		// user or channel using channel prefix
 		ContactHandle4 getCU(std::string_view name);
 
+		const UpdateStats& getUpdateStats(void) const;
+
+	private: // name index
+		// folded by CASEMAPPING, valid until the next call
+		const std::string& nameKey(std::string_view name);
+		void rebuildNameIndex(void);
+		void indexChannel(Contact4 c, std::string_view name);
+		void indexUser(Contact4 c, std::string_view name);
+		void onChannelNameDestroy(ContactRegistry4& cr, const Contact4 c);
+		void onUserNameDestroy(ContactRegistry4& cr, const Contact4 c);
+
+		// getU() without creating contacts for lazy members
+		ContactHandle4 findU(std::string_view nick);
+		// the contact for a nick that has none indexed, reusing one with the same id
+		// sets up the name components, the caller throws the event
+		ContactHandle4 makeU(std::string_view nick, bool& created);
+
+	private: // membership
+		// keep ParentOf, ChannelMembers and UserChannels in sync, return true if anything changed
+		bool addMember(ContactHandle4 channel, Contact4 user, uint8_t privileges = 0);
+		bool removeMember(ContactHandle4 channel, Contact4 user);
+		// we left (part, kick), the list is stale until the next join brings NAMES
+		bool clearMembers(ContactHandle4 channel);
+		void addUserChannel(Contact4 user, Contact4 channel);
+		void removeUserChannel(Contact4 user, Contact4 channel);
+
+		// lazy_members, return true if anything changed
+		LazyUser* findLazyU(std::string_view nick);
+		bool addLazyMember(Contact4 channel, std::string_view nick, uint8_t privileges);
+		bool removeLazyMember(Contact4 channel, LazyUser& user); // might free user
+		// out of every channel (eg. quit), frees user
+		void dropLazyU(LazyUser& user, const IRCClient::Tags& tags);
+		// contact for a lazy user, takes over its memberships
+		ContactHandle4 materializeU(LazyUser& user);
+		// MemberCount from both lists, returns true if it changed
+		bool updateMemberCount(ContactHandle4 channel);
+
+		// (re)queues the user as idle if it is in no channel, or takes it out
+		void updateIdle(Contact4 user);
+		void evictIdleUsers(void);
+
+		// throw now, or once per round if deferred
+		void contactConstructed(Contact4 c);
+		void contactChanged(Contact4 c);
+		// or at the end of the batch the event is part of
+		void contactChanged(Contact4 c, const IRCClient::Tags& tags);
+		void markDirty(Contact4 c, bool constructed); // not counted as requested
+		void flushDirty(void);
+		// replaces the member list with a complete NAMES reply
+		void applyNames(ContactHandle4 channel, const std::vector<PendingName>& names);
+
+	private: // connecting
+		// (re)joins the known channels of this server and the queued ones,
+		// comma packed within the servers limits
+		// favorites (config "favorite" per channel) first, then by ChannelActivity
+		void rejoin(void);
+
 	private: // ircclient
 		bool onEvent(const IRCClient::Events::Connect& e) override;
 		bool onEvent(const IRCClient::Events::Numeric& e) override;
 		bool onEvent(const IRCClient::Events::Join& e) override;
 		bool onEvent(const IRCClient::Events::Part& e) override;
+		bool onEvent(const IRCClient::Events::Mode& e) override;
+		bool onEvent(const IRCClient::Events::Kick& e) override;
 		bool onEvent(const IRCClient::Events::Topic& e) override;
 		bool onEvent(const IRCClient::Events::Quit& e) override;
+		bool onEvent(const IRCClient::Events::Nick& e) override;
 		bool onEvent(const IRCClient::Events::CTCP_Req&) override;
+		bool onEvent(const IRCClient::Events::Batch& e) override;
 		bool onEvent(const IRCClient::Events::Disconnect&) override;
+		bool onEvent(const IRCClient::Events::DispatchDone&) override;
 };
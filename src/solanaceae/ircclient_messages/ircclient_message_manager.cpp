@@ -3,6 +3,7 @@
 #include <solanaceae/util/time.hpp>
 
 #include <solanaceae/ircclient_contacts/components.hpp>
+#include <solanaceae/ircclient/log.hpp>
 
 #include <solanaceae/contact/components.hpp>
 #include <solanaceae/contact/contact_store_i.hpp>
@@ -17,7 +18,7 @@
 #include <cstdint>
 #include <string_view>
 #include <vector>
-#include <iostream>
+#include <algorithm>
 
 IRCClientMessageManager::IRCClientMessageManager(
 	RegistryMessageModelI& rmm,
@@ -40,8 +41,30 @@ IRCClientMessageManager::IRCClientMessageManager(
 IRCClientMessageManager::~IRCClientMessageManager(void) {
 }
 
-bool IRCClientMessageManager::processMessage(ContactHandle4 from, ContactHandle4 to, std::string_view message_text, bool action) {
-	const uint64_t ts = getTimeMS();
+bool IRCClientMessageManager::processMessage(ContactHandle4 from, ContactHandle4 to, std::string_view message_text, bool action, const IRCClient::Tags& tags) {
+	// server-time is also right for history replays, and saves asking the clock
+	uint64_t ts {0};
+	if (_ircc.hasCap(IRCClient::Cap::server_time)) {
+		if (const auto time_tag = tags.get("time"); time_tag.has_value()) {
+			ts = IRCClient::parseServerTime(time_tag.value()).value_or(0);
+		}
+	}
+	if (ts == 0) {
+		ts = getTimeMS();
+	}
+
+	// the message points at its author, which keeps it from being evicted
+	if (!from.all_of<Contact::Components::IRC::TagMessageAuthor>()) {
+		from.emplace<Contact::Components::IRC::TagMessageAuthor>();
+	}
+
+	if (to.all_of<Contact::Components::IRC::ChannelName>()) {
+		auto& activity = to.get_or_emplace<Contact::Components::IRC::ChannelActivity>();
+		activity.last_ts = std::max(activity.last_ts, ts);
+	} else if (to.all_of<Contact::Components::TagSelfStrong>()) {
+		auto& activity = from.get_or_emplace<Contact::Components::IRC::PrivateActivity>();
+		activity.last_ts = std::max(activity.last_ts, ts);
+	}
 
 	Message3Registry* reg_ptr = nullptr;
 	if (to.all_of<Contact::Components::TagSelfStrong>()) {
@@ -50,7 +73,7 @@ bool IRCClientMessageManager::processMessage(ContactHandle4 from, ContactHandle4
 		reg_ptr = _rmm.get(to);
 	}
 	if (reg_ptr == nullptr) {
-		std::cerr << "IRCCMM error: cant find reg\n";
+		IRCC_LOG_ERROR("IRCCMM error: cant find reg");
 		return false;
 	}
 
@@ -89,6 +112,11 @@ bool IRCClientMessageManager::sendText(const Contact4 c, std::string_view messag
 		return false;
 	}
 
+	// every network has its own manager on the same rmm (pool), only send what belongs to our connection
+	if (const auto* cm = cr.try_get<Contact::Components::ContactModel>(c); cm == nullptr || cm->ptr != &_ircccm) {
+		return false;
+	}
+
 	if (message.empty()) {
 		return false; // TODO: empty messages allowed?
 	}
@@ -118,7 +146,7 @@ bool IRCClientMessageManager::sendText(const Contact4 c, std::string_view messag
 	}
 
 	if (!cr.all_of<Contact::Components::Self>(c)) {
-		std::cerr << "IRCCMM error: cant get self\n";
+		IRCC_LOG_ERROR("IRCCMM error: cant get self");
 		return false;
 	}
 
@@ -129,17 +157,16 @@ bool IRCClientMessageManager::sendText(const Contact4 c, std::string_view messag
 				continue;
 			}
 
-			std::string tmp_message{inner_str}; // string_view might not be nul terminated
 			if (action) {
-				if (irc_cmd_me(_ircc.getSession(), to_str.c_str(), tmp_message.c_str()) != 0) {
-					std::cerr << "IRCCMM error: failed to send action\n";
+				if (!_ircc.sendAction(to_str, inner_str)) {
+					IRCC_LOG_ERROR("IRCCMM error: failed to send action");
 
 					// we dont have offline messaging in irc
 					return false;
 				}
 			} else {
-				if (irc_cmd_msg(_ircc.getSession(), to_str.c_str(), tmp_message.c_str()) != 0) {
-					std::cerr << "IRCCMM error: failed to send message\n";
+				if (!_ircc.sendMessage(to_str, inner_str)) {
+					IRCC_LOG_ERROR("IRCCMM error: failed to send message");
 
 					// we dont have offline messaging in irc
 					return false;
@@ -150,6 +177,14 @@ bool IRCClientMessageManager::sendText(const Contact4 c, std::string_view messag
 
 	const Contact4 c_self = cr.get<Contact::Components::Self>(c).self;
 
+	if (cr.all_of<Contact::Components::IRC::ChannelName>(c)) {
+		auto& activity = _cs.registry().get_or_emplace<Contact::Components::IRC::ChannelActivity>(c);
+		activity.last_ts = std::max(activity.last_ts, ts);
+	} else if (cr.all_of<Contact::Components::IRC::UserName>(c)) {
+		auto& activity = _cs.registry().get_or_emplace<Contact::Components::IRC::PrivateActivity>(c);
+		activity.last_ts = std::max(activity.last_ts, ts);
+	}
+
 	auto new_msg = Message3Handle{*reg_ptr, reg_ptr->create()};
 
 	new_msg.emplace<Message::Components::ContactFrom>(c_self);
@@ -174,7 +209,7 @@ bool IRCClientMessageManager::sendText(const Contact4 c, std::string_view messag
 
 bool IRCClientMessageManager::onEvent(const IRCClient::Events::Channel& e) {
 	if (e.params.size() < 2) {
-		std::cerr << "IRCCMM error: channel event too few params\n";
+		IRCC_LOG_ERROR("IRCCMM error: channel event too few params");
 		return false;
 	}
 
@@ -182,40 +217,40 @@ bool IRCClientMessageManager::onEvent(const IRCClient::Events::Channel& e) {
 	// e.origin is sender
 	auto sender =  _ircccm.getU(e.origin); // assuming its always a user // aka ContactFrom
 	if (!static_cast<bool>(sender)) {
-		std::cerr << "IRCCMM error: channel event unknown sender\n";
+		IRCC_LOG_WARN("IRCCMM warning: channel event unknown sender");
 		return false;
 	}
 
 	// e.params.at(0) is channel
 	auto channel =  _ircccm.getC(e.params.at(0)); // aka ContactTo
 	if (!static_cast<bool>(channel)) {
-		std::cerr << "IRCCMM error: channel event unknown channel\n";
+		IRCC_LOG_WARN("IRCCMM warning: channel event unknown channel");
 		return false;
 	}
 
 	// e.params.at(1) is message
 	const auto& message_text = e.params.at(1);
 
-	return processMessage(sender, channel, message_text, false);
+	return processMessage(sender, channel, message_text, false, e.tags);
 }
 
 bool IRCClientMessageManager::onEvent(const IRCClient::Events::PrivMSG& e) {
 	if (e.params.size() < 2) {
-		std::cerr << "IRCCMM error: privmsg event too few params\n";
+		IRCC_LOG_ERROR("IRCCMM error: privmsg event too few params");
 		return false;
 	}
 
 	// e.origin is sender
 	auto from =  _ircccm.getU(e.origin); // assuming its always a user // aka ContactFrom
 	if (!static_cast<bool>(from)) {
-		std::cerr << "IRCCMM error: privmsg event unknown sender\n";
+		IRCC_LOG_WARN("IRCCMM warning: privmsg event unknown sender");
 		return false;
 	}
 
 	// e.params.at(0) is receiver (us?)
 	auto to =  _ircccm.getU(e.params.at(0)); // aka ContactTo
 	if (!static_cast<bool>(to)) {
-		std::cerr << "IRCCMM error: privmsg event unknown channel\n";
+		IRCC_LOG_WARN("IRCCMM warning: privmsg event unknown channel");
 		return false;
 	}
 
@@ -224,12 +259,12 @@ bool IRCClientMessageManager::onEvent(const IRCClient::Events::PrivMSG& e) {
 	from.emplace_or_replace<Contact::Components::TagBig>(); // could be like an invite?
 	from.emplace_or_replace<Contact::Components::TagPrivate>();
 
-	return processMessage(from, to, e.params.at(1), false);
+	return processMessage(from, to, e.params.at(1), false, e.tags);
 }
 
 bool IRCClientMessageManager::onEvent(const IRCClient::Events::Notice& e) {
 	if (e.params.size() < 2) {
-		std::cerr << "IRCCMM error: notice event too few params\n";
+		IRCC_LOG_ERROR("IRCCMM error: notice event too few params");
 		return false;
 	}
 
@@ -253,47 +288,47 @@ bool IRCClientMessageManager::onEvent(const IRCClient::Events::Notice& e) {
 
 bool IRCClientMessageManager::onEvent(const IRCClient::Events::ChannelNotice& e) {
 	if (e.params.size() < 2) {
-		std::cerr << "IRCCMM error: channel notice event too few params\n";
+		IRCC_LOG_ERROR("IRCCMM error: channel notice event too few params");
 		return false;
 	}
 
 	// e.origin is sending user (probably)
 	auto from = _ircccm.getU(e.origin);
 	if (!static_cast<bool>(from)) {
-		std::cerr << "IRCCMM error: channel notice event unknown sender\n";
+		IRCC_LOG_WARN("IRCCMM warning: channel notice event unknown sender");
 		return false;
 	}
 
 	// e.params.at(0) is channel
 	auto to = _ircccm.getC(e.params.at(0));
 	if (!static_cast<bool>(to)) {
-		std::cerr << "IRCCMM error: unknown receiver\n";
+		IRCC_LOG_WARN("IRCCMM warning: unknown receiver");
 		return false;
 	}
 
 	// TODO: add notice tag
 
 	// e.params.at(1) is message
-	return processMessage(from, to, e.params.at(1), false);
+	return processMessage(from, to, e.params.at(1), false, e.tags);
 }
 
 bool IRCClientMessageManager::onEvent(const IRCClient::Events::CTCP_Action& e) {
 	if (e.params.size() < 2) {
-		std::cerr << "IRCCMM error: action event too few params\n";
+		IRCC_LOG_ERROR("IRCCMM error: action event too few params");
 		return false;
 	}
 
 	// e.origin is sender
 	auto from = _ircccm.getU(e.origin); // assuming its always a user // aka ContactFrom
 	if (!static_cast<bool>(from)) {
-		std::cerr << "IRCCMM error: channel event unknown sender\n";
+		IRCC_LOG_WARN("IRCCMM warning: channel event unknown sender");
 		return false;
 	}
 
 	// e.params.at(0) is receiver (self if pm or channel if channel)
 	auto receiver = _ircccm.getCU(e.params.at(0));
 	if (!static_cast<bool>(receiver)) {
-		std::cerr << "IRCCMM error: unknown receiver\n";
+		IRCC_LOG_WARN("IRCCMM warning: unknown receiver");
 		return false;
 	}
 	// e.params.at(1) is message
@@ -303,6 +338,6 @@ bool IRCClientMessageManager::onEvent(const IRCClient::Events::CTCP_Action& e) {
 		from.emplace_or_replace<Contact::Components::TagBig>(); // could be like an invite?
 	}
 
-	return processMessage(from, receiver, e.params.at(1), true);
+	return processMessage(from, receiver, e.params.at(1), true, e.tags);
 }
 
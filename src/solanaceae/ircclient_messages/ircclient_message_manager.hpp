@@ -29,7 +29,7 @@ class IRCClientMessageManager : public IRCClientEventI, public RegistryMessageMo
 		using IRCClientEventI::onEvent;
 		using RegistryMessageModelEventI::onEvent;
 	private:
-		bool processMessage(ContactHandle4 from, ContactHandle4 to, std::string_view message_text, bool action);
+		bool processMessage(ContactHandle4 from, ContactHandle4 to, std::string_view message_text, bool action, const IRCClient::Tags& tags);
 
 	private: // mm3
 		bool sendText(const Contact4 c, std::string_view message, bool action = false) override;
@@ -0,0 +1,98 @@
+#include <solanaceae/util/simple_config_model.hpp>
+#include <solanaceae/contact/contact_store_impl.hpp>
+#include <solanaceae/message3/registry_message_model_impl.hpp>
+#include <solanaceae/ircclient/ircclient_pool.hpp>
+#include <solanaceae/ircclient_contacts/ircclient_contact_model.hpp>
+#include <solanaceae/ircclient_messages/ircclient_message_manager.hpp>
+
+#include "./mock_irc_server.hpp"
+
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <chrono>
+
+// two networks in one pool, like the plugin sets them up (one contact model and message manager each, shared rmm)
+// a message to a channel has to go out on the connection of that channels network, and only there
+
+int main(void) {
+	MockIRCServer::Script script;
+	script.users_per_channel = 2;
+	script.messages = 0;
+
+	MockIRCServer server_a{script};
+	MockIRCServer server_b{script};
+	if (!server_a.start() || !server_b.start()) {
+		std::cerr << "failed to start the mock servers\n";
+		return 1;
+	}
+
+	SimpleConfigModel conf;
+	for (const auto& [network, server] : {std::pair{"a", &server_a}, std::pair{"b", &server_b}}) {
+		conf.set("IRCClientPool", "networks", network, true);
+
+		const std::string section = IRCClientPool::configSection(network);
+		conf.set(section, "server", std::string_view{"127.0.0.1"});
+		conf.set(section, "port", int64_t{server->getPort()});
+		conf.set(section, "transport", std::string_view{"native"});
+		conf.set(section, "nick", std::string_view{"test"});
+		conf.set(section, "flood_control", false);
+		conf.set(section, "autojoin", MockIRCServer::channelName(0), true);
+	}
+
+	ContactStore4Impl cs;
+	RegistryMessageModelImpl rmm{cs};
+
+	IRCClientPool pool{conf};
+	std::vector<std::unique_ptr<IRCClientContactModel>> ircccms;
+	std::vector<std::unique_ptr<IRCClientMessageManager>> irccmms;
+	for (size_t i = 0; i < pool.size(); i++) {
+		auto& ircc = pool.getClient(i);
+		ircccms.push_back(std::make_unique<IRCClientContactModel>(cs, conf, ircc));
+		irccmms.push_back(std::make_unique<IRCClientMessageManager>(rmm, cs, conf, ircc, *ircccms.back()));
+	}
+
+	const auto runFor = [&](std::chrono::milliseconds duration, auto&& done) {
+		const auto start = std::chrono::steady_clock::now();
+		while (!done() && std::chrono::steady_clock::now() - start < duration) {
+			pool.iterate(0.001f);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return done();
+	};
+
+	const auto channel = [&](size_t network) {
+		return ircccms.at(network)->getC(MockIRCServer::channelName(0));
+	};
+
+	if (!runFor(std::chrono::seconds{10}, [&]() { return static_cast<bool>(channel(0)) && static_cast<bool>(channel(1)); })) {
+		std::cerr << "FAIL: channels not joined\n";
+		return 1;
+	}
+
+	int fails {0};
+	const auto check = [&](bool ok, std::string_view what) {
+		if (!ok) {
+			std::cerr << "FAIL: " << what << " (a:" << server_a.getPrivmsgsReceived() << " b:" << server_b.getPrivmsgsReceived() << ")\n";
+			fails++;
+		}
+	};
+
+	// b was subscribed last, so its manager only gets asked if a's declines
+	rmm.sendText(channel(1).entity(), "to b");
+	runFor(std::chrono::milliseconds{500}, [&]() { return server_b.getPrivmsgsReceived() == 1; });
+	check(server_a.getPrivmsgsReceived() == 0 && server_b.getPrivmsgsReceived() == 1, "message to b");
+
+	rmm.sendText(channel(0).entity(), "to a");
+	runFor(std::chrono::milliseconds{500}, [&]() { return server_a.getPrivmsgsReceived() == 1; });
+	check(server_a.getPrivmsgsReceived() == 1 && server_b.getPrivmsgsReceived() == 1, "message to a");
+
+	server_a.stop();
+	server_b.stop();
+
+	std::cout << (fails == 0 ? "ok\n" : "FAILED\n");
+	return fails == 0 ? 0 : 1;
+}